@@ -0,0 +1,239 @@
+/*
+ * @Description: Benchmark of appsink delivery and queueing.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 18:06:21
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 18:06:21
+ */
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+#include <gst/gst.h>
+#include <gst/app/app.h>
+
+static const int FRAMES = 1000;
+
+enum DeliveryMode {
+    DELIVERY_SIGNAL = 0,    /* emit-signals + "pull-sample" action signal */
+    DELIVERY_CALLBACK,      /* GstAppSinkCallbacks + gst_app_sink_pull_sample */
+};
+
+static GstFlowReturn cb_signal_new_sample(GstElement* appsink, gpointer user_data)
+{
+    GstSample* sample = nullptr;
+
+    g_signal_emit_by_name(appsink, "pull-sample", &sample);
+    if (sample) {
+        (*static_cast<uint64_t*>(user_data))++;
+        gst_sample_unref(sample);
+    }
+
+    return GST_FLOW_OK;
+}
+
+static GstFlowReturn cb_callback_new_sample(GstAppSink* appsink, gpointer user_data)
+{
+    GstSample* sample = gst_app_sink_pull_sample(appsink);
+
+    if (sample) {
+        (*static_cast<uint64_t*>(user_data))++;
+        gst_sample_unref(sample);
+    }
+
+    return GST_FLOW_OK;
+}
+
+static GstPadProbeReturn cb_count_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    (*static_cast<std::atomic<uint64_t>*>(user_data))++;
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstElement* make_pipeline(benchmark::State& state, int width, int height,
+    const std::string& appsink_props)
+{
+    GError* error = nullptr;
+    std::string desc = "videotestsrc num-buffers=" + std::to_string(FRAMES) +
+        " pattern=black ! video/x-raw,format=RGBA,width=" + std::to_string(width) +
+        ",height=" + std::to_string(height) + " ! appsink name=sink sync=false " +
+        appsink_props;
+
+    GstElement* pipeline = gst_parse_launch(desc.c_str(), &error);
+    if (!pipeline || error) {
+        state.SkipWithError(error ? error->message : "Failed to create pipeline");
+        if (error) {
+            g_error_free(error);
+        }
+        if (pipeline) {
+            gst_object_unref(pipeline);
+        }
+        return nullptr;
+    }
+
+    return pipeline;
+}
+
+static bool run_to_eos(GstElement* pipeline)
+{
+    GstBus* bus = gst_element_get_bus(pipeline);
+    bool ret = true;
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    GstMessage* msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+        (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+
+    if (!msg || GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+        ret = false;
+    }
+    if (msg) {
+        gst_message_unref(msg);
+    }
+    gst_object_unref(bus);
+
+    return ret;
+}
+
+/*
+ * Frames pulled in the streaming thread as soon as they arrive, tiny frames
+ * so the numbers are dominated by the delivery path instead of the video.
+ */
+static void BM_AppsinkDelivery(benchmark::State& state)
+{
+    const DeliveryMode mode = (DeliveryMode)state.range(0);
+    uint64_t pulled = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        GstElement* pipeline = make_pipeline(state, 64, 64,
+            mode == DELIVERY_SIGNAL ? "emit-signals=true" : "emit-signals=false");
+        if (!pipeline) {
+            break;
+        }
+
+        GstElement* appsink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+        if (mode == DELIVERY_SIGNAL) {
+            g_signal_connect(appsink, "new-sample",
+                G_CALLBACK(cb_signal_new_sample), &pulled);
+        } else {
+            GstAppSinkCallbacks callbacks = { };
+            callbacks.new_sample = cb_callback_new_sample;
+            gst_app_sink_set_callbacks(GST_APP_SINK(appsink), &callbacks, &pulled, nullptr);
+        }
+        gst_object_unref(appsink);
+        state.ResumeTiming();
+
+        if (!run_to_eos(pipeline)) {
+            state.SkipWithError("Pipeline posted an error");
+        }
+
+        state.PauseTiming();
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_object_unref(pipeline);
+        state.ResumeTiming();
+    }
+
+    state.SetLabel(mode == DELIVERY_SIGNAL ? "signal" : "callback");
+    state.SetItemsProcessed(pulled);
+}
+
+BENCHMARK(BM_AppsinkDelivery)
+    ->ArgName("callback")
+    ->Arg(DELIVERY_SIGNAL)
+    ->Arg(DELIVERY_CALLBACK)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/*
+ * The consumer pulls from its own thread and needs 2ms per frame, far
+ * slower than videotestsrc. Samples queued inside appsink are the ones
+ * that arrived at its sink pad after the one just pulled, videotestsrc
+ * numbers its frames in the buffer offset.
+ */
+static void BM_AppsinkSlowConsumer(benchmark::State& state)
+{
+    const int max_buffers = state.range(0);
+    const bool drop = state.range(1);
+    const int width = 640, height = 360;
+    std::atomic<uint64_t> arrived(0);
+    uint64_t pulled = 0, peak = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::string props = "emit-signals=false max-buffers=" + std::to_string(max_buffers) +
+            " drop=" + (drop ? "true" : "false");
+        GstElement* pipeline = make_pipeline(state, width, height, props);
+        if (!pipeline) {
+            break;
+        }
+
+        arrived = 0;
+        GstElement* appsink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+        GstPad* sinkpad = gst_element_get_static_pad(appsink, "sink");
+        gst_pad_add_probe(sinkpad, GST_PAD_PROBE_TYPE_BUFFER, cb_count_probe, &arrived, nullptr);
+        gst_object_unref(sinkpad);
+        state.ResumeTiming();
+
+        // appsink reports eos until started
+        gst_element_set_state(pipeline, GST_STATE_PLAYING);
+        std::thread consumer([&]() {
+            while (!gst_app_sink_is_eos(GST_APP_SINK(appsink))) {
+                GstSample* sample = gst_app_sink_try_pull_sample(GST_APP_SINK(appsink), 100 * GST_MSECOND);
+                if (!sample) {
+                    continue;
+                }
+                pulled++;
+                // the oldest sample is dropped first, all frames after this one are still queued
+                uint64_t queued = arrived.load() - GST_BUFFER_OFFSET(gst_sample_get_buffer(sample)) - 1;
+                peak = queued > peak ? queued : peak;
+                gst_sample_unref(sample);
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        });
+
+        if (!run_to_eos(pipeline)) {
+            state.SkipWithError("Pipeline posted an error");
+        }
+        consumer.join();
+
+        state.PauseTiming();
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_object_unref(appsink);
+        gst_object_unref(pipeline);
+        state.ResumeTiming();
+    }
+
+    state.counters["peak_queued"] = peak;
+    state.counters["peak_queued_MB"] = peak * width * height * 4 / 1e6;
+    state.counters["dropped%"] = 100.0 * (1.0 - (double)pulled / (state.iterations() * FRAMES));
+    state.SetItemsProcessed(pulled);
+}
+
+BENCHMARK(BM_AppsinkSlowConsumer)
+    ->ArgNames({"max_buffers", "drop"})
+    ->Args({0, 0})
+    ->Args({4, 0})
+    ->Args({4, 1})
+    ->Args({1, 1})
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+int main(int argc, char** argv)
+{
+    gst_init(&argc, &argv);
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return 0;
+}
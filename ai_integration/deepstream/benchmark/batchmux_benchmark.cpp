@@ -0,0 +1,123 @@
+/*
+ * @Description: Benchmark of batching N sources with cpubatchmux.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 16:52:37
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 16:52:37
+ */
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <gst/gst.h>
+
+#include "gstcpubatchmux.h"
+
+static const int FRAMES_PER_SOURCE = 300;
+
+struct BatchCounter {
+    uint64_t batches;
+    uint64_t frames;
+};
+
+static GstPadProbeReturn cb_count_batch_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    BatchCounter* counter = static_cast<BatchCounter*>(user_data);
+    GstBatchMeta* meta = gst_buffer_get_batch_meta(GST_PAD_PROBE_INFO_BUFFER(info));
+
+    counter->batches++;
+    counter->frames += meta ? meta->frames->len : 0;
+
+    return GST_PAD_PROBE_OK;
+}
+
+/*
+ * N videotestsrc ! cpubatchmux ! fakesink, run to EOS as fast as possible.
+ * Frames are not copied by the muxer, so the numbers cover scheduling and
+ * meta handling per batch.
+ */
+static void BM_CpuBatchMux(benchmark::State& state)
+{
+    const int sources = state.range(0);
+    const int width = state.range(1);
+    const int height = state.range(2);
+    BatchCounter counter = { 0, 0 };
+
+    std::string desc = "cpubatchmux name=mux ! fakesink sync=false";
+    for (int i = 0; i < sources; i++) {
+        desc += " videotestsrc num-buffers=" + std::to_string(FRAMES_PER_SOURCE) +
+            " pattern=black ! video/x-raw,format=RGBA,width=" + std::to_string(width) +
+            ",height=" + std::to_string(height) + " ! mux.sink_" + std::to_string(i);
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        GError* error = nullptr;
+        GstElement* pipeline = gst_parse_launch(desc.c_str(), &error);
+        if (!pipeline || error) {
+            state.SkipWithError(error ? error->message : "Failed to create pipeline");
+            if (error) {
+                g_error_free(error);
+            }
+            break;
+        }
+
+        GstElement* mux = gst_bin_get_by_name(GST_BIN(pipeline), "mux");
+        GstPad* srcpad = gst_element_get_static_pad(mux, "src");
+        gst_pad_add_probe(srcpad, GST_PAD_PROBE_TYPE_BUFFER,
+            cb_count_batch_probe, &counter, nullptr);
+        gst_object_unref(srcpad);
+        gst_object_unref(mux);
+
+        GstBus* bus = gst_element_get_bus(pipeline);
+        state.ResumeTiming();
+
+        gst_element_set_state(pipeline, GST_STATE_PLAYING);
+        GstMessage* msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+            (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+
+        state.PauseTiming();
+        if (msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+            state.SkipWithError("Pipeline posted an error");
+        }
+        if (msg) {
+            gst_message_unref(msg);
+        }
+        gst_object_unref(bus);
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_object_unref(pipeline);
+        state.ResumeTiming();
+    }
+
+    state.counters["batches"] = benchmark::Counter(counter.batches, benchmark::Counter::kIsRate);
+    state.counters["frames/batch"] = counter.batches ? (double)counter.frames / counter.batches : 0;
+    state.SetItemsProcessed(counter.frames);
+}
+
+BENCHMARK(BM_CpuBatchMux)
+    ->ArgNames({"sources", "width", "height"})
+    ->Args({1, 1920, 1080})
+    ->Args({4, 1920, 1080})
+    ->Args({8, 1920, 1080})
+    ->Args({16, 1280, 720})
+    ->Args({32, 640, 360})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+int main(int argc, char** argv)
+{
+    gst_init(&argc, &argv);
+    if (!gst_cpu_batch_mux_register()) {
+        return -1;
+    }
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return 0;
+}
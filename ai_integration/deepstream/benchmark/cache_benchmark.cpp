@@ -0,0 +1,273 @@
+/*
+ * @Description: Micro benchmark of the buffer caches hand-off.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 11:20:36
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 04:45:22
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "Common.h"
+#include "DoubleBufferCache.h"
+#include "TripleBufferCache.h"
+#include "RingBufferCache.h"
+
+/*
+ * Payload factories, one shared_ptr per fed frame just like the appsink
+ * callback produces. Pixel data is allocated once and shared, the numbers
+ * only cover the hand-off itself.
+ */
+template<typename T>
+struct Payload;
+
+template<>
+struct Payload<cv::Mat> {
+    static cv::Mat& image() {
+        static cv::Mat img(1080, 1920, CV_8UC3, cv::Scalar(0, 0, 0));
+        return img;
+    }
+    static std::shared_ptr<cv::Mat> make(uint64_t) {
+        return std::make_shared<cv::Mat>(image());
+    }
+};
+
+template<>
+struct Payload<GstSampleObject> {
+    static GstSample* sample() {
+        static GstSample* s = nullptr;
+        if (!s) {
+            gst_init(nullptr, nullptr);
+            GstCaps* caps = gst_caps_new_simple("video/x-raw",
+                "format", G_TYPE_STRING, "RGBA",
+                "width", G_TYPE_INT, 1920,
+                "height", G_TYPE_INT, 1080,
+                "framerate", GST_TYPE_FRACTION, 30, 1, nullptr);
+            GstBuffer* buffer = gst_buffer_new_allocate(nullptr, 1920 * 1080 * 4, nullptr);
+            s = gst_sample_new(buffer, caps, nullptr, nullptr);
+            gst_buffer_unref(buffer);
+            gst_caps_unref(caps);
+        }
+        return s;
+    }
+    static std::shared_ptr<GstSampleObject> make(uint64_t ts) {
+        return std::make_shared<GstSampleObject>(gst_sample_ref(sample()), ts);
+    }
+};
+
+template<>
+struct Payload<std::vector<OSDObject> > {
+    static std::shared_ptr<std::vector<OSDObject> > make(uint64_t) {
+        auto results = std::make_shared<std::vector<OSDObject> >();
+        results->reserve(16);
+        for (int i = 0; i < 16; i++) {
+            results->emplace_back(i * 100, i * 50, 80, 160, 255, 0, 0);
+        }
+        return results;
+    }
+};
+
+template<>
+struct Payload<OSDResultBatch> {
+    static std::shared_ptr<OSDResultBatch> make(uint64_t ts) {
+        auto results = std::make_shared<OSDResultBatch>(16, ts);
+        for (int i = 0; i < 16; i++) {
+            results->Add(i * 100, i * 50, 80, 160, OSDResultBatch::PackRGBA(1.0, 0, 0));
+        }
+        return results;
+    }
+};
+
+/*
+ * Latency: feed one frame and fetch it back on the same thread.
+ */
+template<typename T>
+static void BM_DoubleBufCache_Latency(benchmark::State& state)
+{
+    DoubleBufCache<T> cache;
+    uint64_t i = 0;
+    for (auto _ : state) {
+        cache.feed(Payload<T>::make(i++));
+        benchmark::DoNotOptimize(cache.fetch());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template<typename T>
+static void BM_TripleBufCache_Latency(benchmark::State& state)
+{
+    TripleBufCache<T> cache;
+    std::shared_ptr<T> out;
+    uint64_t i = 0;
+    for (auto _ : state) {
+        cache.feed(Payload<T>::make(i++));
+        benchmark::DoNotOptimize(cache.fetch_if_new(out));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template<typename T>
+static void BM_RingBufCache_Latency(benchmark::State& state)
+{
+    RingBufCache<T> cache(8);
+    std::shared_ptr<T> out;
+    uint64_t i = 0;
+    for (auto _ : state) {
+        cache.feed(Payload<T>::make(i++));
+        benchmark::DoNotOptimize(cache.pop(out));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/*
+ * Throughput: thread 0 feeds, the other threads fetch concurrently.
+ * "feed" and "fetch" counters report the per-second rate of each role.
+ */
+template<typename T>
+static void BM_DoubleBufCache_Throughput(benchmark::State& state)
+{
+    static DoubleBufCache<T>* cache = nullptr;
+    if (state.thread_index() == 0) {
+        cache = new DoubleBufCache<T>();
+    }
+
+    uint64_t i = 0, seq = 0, hits = 0;
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            cache->feed(Payload<T>::make(i++));
+        } else if (cache->fetch_wait_newer(seq, 0)) {
+            hits++;
+        }
+    }
+
+    if (state.thread_index() == 0) {
+        state.counters["feed"] = benchmark::Counter(i, benchmark::Counter::kIsRate);
+        delete cache;
+        cache = nullptr;
+    } else {
+        state.counters["fetch"] = benchmark::Counter(hits, benchmark::Counter::kIsRate);
+    }
+}
+
+template<typename T>
+static void BM_TripleBufCache_Throughput(benchmark::State& state)
+{
+    static TripleBufCache<T>* cache = nullptr;
+    if (state.thread_index() == 0) {
+        cache = new TripleBufCache<T>();
+    }
+
+    std::shared_ptr<T> out;
+    uint64_t i = 0, hits = 0;
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            cache->feed(Payload<T>::make(i++));
+        } else if (cache->fetch_if_new(out)) {
+            hits++;
+        }
+    }
+
+    if (state.thread_index() == 0) {
+        state.counters["feed"] = benchmark::Counter(i, benchmark::Counter::kIsRate);
+        delete cache;
+        cache = nullptr;
+    } else {
+        state.counters["fetch"] = benchmark::Counter(hits, benchmark::Counter::kIsRate);
+    }
+}
+
+template<typename T>
+static void BM_RingBufCache_Throughput(benchmark::State& state)
+{
+    static RingBufCache<T>* cache = nullptr;
+    if (state.thread_index() == 0) {
+        cache = new RingBufCache<T>(64);
+    }
+
+    std::shared_ptr<T> out;
+    uint64_t i = 0, hits = 0;
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            cache->feed(Payload<T>::make(i++));
+        } else if (cache->pop(out)) {
+            hits++;
+        }
+    }
+
+    if (state.thread_index() == 0) {
+        state.counters["feed"] = benchmark::Counter(i, benchmark::Counter::kIsRate);
+        state.counters["dropped"] = cache->dropped();
+        delete cache;
+        cache = nullptr;
+    } else {
+        state.counters["fetch"] = benchmark::Counter(hits, benchmark::Counter::kIsRate);
+    }
+}
+
+/*
+ * Allocation of the handles themselves: heap vs pooled.
+ */
+static void BM_SampleObject_MakeShared(benchmark::State& state)
+{
+    uint64_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Payload<GstSampleObject>::make(i++));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SampleObject_MakeShared);
+
+static void BM_SampleObject_Pool(benchmark::State& state)
+{
+    GstSampleObjectPool pool(16);
+    GstSample* sample = Payload<GstSampleObject>::sample();
+    uint64_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(pool.make(gst_sample_ref(sample), i++));
+    }
+    state.counters["miss"] = pool.misses();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SampleObject_Pool);
+
+static void BM_OSDResult_MakeShared(benchmark::State& state)
+{
+    uint64_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Payload<std::vector<OSDObject> >::make(i++));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OSDResult_MakeShared);
+
+static void BM_OSDResult_Pool(benchmark::State& state)
+{
+    OSDResultPool pool(16);
+    for (auto _ : state) {
+        auto results = pool.acquire();
+        for (int i = 0; i < 16; i++) {
+            results->emplace_back(i * 100, i * 50, 80, 160, 255, 0, 0);
+        }
+        benchmark::DoNotOptimize(results);
+    }
+    state.counters["miss"] = pool.misses();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OSDResult_Pool);
+
+#define REGISTER_CACHE_BENCHMARKS(T)                                        \
+    BENCHMARK_TEMPLATE(BM_DoubleBufCache_Latency, T);                      \
+    BENCHMARK_TEMPLATE(BM_TripleBufCache_Latency, T);                      \
+    BENCHMARK_TEMPLATE(BM_RingBufCache_Latency, T);                        \
+    BENCHMARK_TEMPLATE(BM_DoubleBufCache_Throughput, T)->DenseThreadRange(2, 9)->UseRealTime(); \
+    BENCHMARK_TEMPLATE(BM_TripleBufCache_Throughput, T)->Threads(2)->UseRealTime();             \
+    BENCHMARK_TEMPLATE(BM_RingBufCache_Throughput, T)->DenseThreadRange(2, 9)->UseRealTime();
+
+// 1 producer with 1..8 consumers, TripleBufCache only supports one consumer.
+REGISTER_CACHE_BENCHMARKS(cv::Mat)
+REGISTER_CACHE_BENCHMARKS(GstSampleObject)
+REGISTER_CACHE_BENCHMARKS(std::vector<OSDObject>)
+REGISTER_CACHE_BENCHMARKS(OSDResultBatch)
+
+BENCHMARK_MAIN();
@@ -0,0 +1,67 @@
+/*
+ * @Description: Element profiles of the platforms VideoPipeline runs on.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 19:12:40
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 19:12:40
+ */
+#pragma once
+
+#include <string>
+
+typedef enum _BackendType {
+    BACKEND_NVIDIA = 0,             /* DeepStream on Jetson or dGPU */
+    BACKEND_QTI,                    /* Qualcomm GStreamer plugins */
+    BACKEND_SOFTWARE,               /* upstream plugins only, the CPU baseline */
+    BACKEND_NUM
+}BackendType;
+
+/* element factories of a backend, batching with nvstreammux and nvmultistreamtiler is nvidia only */
+typedef struct _BackendProfile {
+    BackendType     type;
+    const char*     name;
+    const char*     decoder;        /* name prefix of the decoder uridecodebin plugs */
+    const char*     converter;      /* color space conversion */
+    const char*     encoder;        /* H.264 */
+    const char*     display;
+    const char*     memory;         /* caps feature of converted frames, nullptr for system memory */
+}BackendProfile;
+
+/**
+ * @brief Profile of the backend.
+ * @Author: Ricardo Lu
+ * @param[in] type - out of range falls back to BACKEND_NVIDIA.
+ */
+inline const BackendProfile& GetBackendProfile(BackendType type)
+{
+    static const BackendProfile profiles[BACKEND_NUM] = {
+        { BACKEND_NVIDIA, "nvidia", "nvv4l2decoder", "nvvideoconvert",
+            "nvv4l2h264enc", "nveglglessink", "memory:NVMM" },
+        { BACKEND_QTI, "qti", "qtivdec", "qtivtransform",
+            "omxh264enc", "waylandsink", nullptr },
+        { BACKEND_SOFTWARE, "software", "avdec_", "videoconvert",
+            "x264enc", "autovideosink", nullptr },
+    };
+
+    return profiles[type >= BACKEND_NVIDIA && type < BACKEND_NUM ? type : BACKEND_NVIDIA];
+}
+
+/**
+ * @brief Backend named in the config.
+ * @Author: Ricardo Lu
+ * @param[in] name - nvidia, qti or software.
+ * @param[out] type
+ * @return false if the name is unknown, type is left untouched.
+ */
+inline bool ParseBackend(const std::string& name, BackendType& type)
+{
+    for (int i = 0; i < BACKEND_NUM; i++) {
+        if (name == GetBackendProfile((BackendType)i).name) {
+            type = (BackendType)i;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -4,7 +4,7 @@
  * @Author: Ricardo Lu<shenglu1202@163.com>
  * @Date: 2021-08-27 12:24:25
  * @LastEditors: Ricardo Lu
- * @LastEditTime: 2022-07-16 13:49:59
+ * @LastEditTime: 2026-10-18 04:45:22
  */
 #pragma once
 
@@ -14,12 +14,18 @@
 #include <functional>
 #include <unistd.h>
 #include <vector>
+#include <mutex>
 
 #include <opencv2/opencv.hpp>
 #include <gst/gst.h>
 #include <gst/app/app.h>
+#include <gst/video/video.h>
 
 #include "Logger.h"
+#include "SharedObjectPool.h"
+#include "OSDResultBatch.h"
+#include "MappedVideoFrame.h"
+#include "MultiScaler.h"
 
 class OSDObject {
 public:
@@ -27,7 +33,7 @@ public:
     double r, g, b, a;
 
     OSDObject(int _x, int _y, int _width, int _height,
-        int _r, int _g, int _b, int _a = 1.0) : 
+        double _r, double _g, double _b, double _a = 1.0) :
         x(_x), y(_y), width(_width), height(_height),
         r(_r), g(_g), b(_b), a(_a) {
 
@@ -66,18 +72,63 @@ private:
     GstBuffer* m_buffer;
 };
 
+/**
+ * @brief Parsed GstVideoInfo of the latest caps seen on a pipeline branch.
+ * Caps almost never change between samples, so the lookup is a pointer
+ * compare and the caps are only parsed again when a new GstCaps arrives.
+ */
+class VideoInfoCache {
+public:
+    VideoInfoCache() : m_caps(nullptr) {
+
+    }
+
+   ~VideoInfoCache() {
+        if (m_caps) {
+            gst_caps_unref(m_caps);
+            m_caps = nullptr;
+        }
+    }
+
+    VideoInfoCache(const VideoInfoCache&) = delete;
+    VideoInfoCache& operator=(const VideoInfoCache&) = delete;
+
+    std::shared_ptr<const GstVideoInfo> Lookup(GstCaps* caps) {
+        if (!caps) {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // the cached caps is kept referenced, so its address can't be reused
+        if (caps != m_caps) {
+            std::shared_ptr<GstVideoInfo> info = std::make_shared<GstVideoInfo>();
+            if (!gst_video_info_from_caps(info.get(), caps)) {
+                return nullptr;
+            }
+
+            gst_caps_replace(&m_caps, caps);
+            m_info = info;
+        }
+
+        return m_info;
+    }
+
+private:
+    std::mutex                          m_mutex;
+    GstCaps*                            m_caps;
+    std::shared_ptr<const GstVideoInfo> m_info;
+};
+
 class GstSampleObject {
 public:
-    GstSampleObject(GstSample* sample, uint64_t timestamp) :
+    GstSampleObject(GstSample* sample, uint64_t timestamp,
+        VideoInfoCache* cache = nullptr) :
         m_sample   (sample),
-        m_timestamp(timestamp),
         m_buffer   (nullptr),
-        m_format   (nullptr),
-        m_rows     (0),
-        m_cols     (0),
-        m_fpsn     (0),
-        m_fpsd     (0) {
-
+        m_timestamp(timestamp) {
+            if (cache && m_sample) {
+                m_info = cache->Lookup(gst_sample_get_caps(m_sample));
+            }
         }
 
    ~GstSampleObject() {
@@ -95,23 +146,45 @@ public:
         return gst_sample_ref(m_sample);
     }
 
-    GstBuffer* GetBuffer(int& width, int& height, std::string& format) {
+    /**
+     * @brief Video info (size, framerate, format, strides and plane offsets)
+     * of the sample, shared with the other samples of the same caps.
+     */
+    std::shared_ptr<const GstVideoInfo> GetVideoInfo() {
+        if (!m_info) {
+            std::shared_ptr<GstVideoInfo> info = std::make_shared<GstVideoInfo>();
+            if (gst_video_info_from_caps(info.get(), gst_sample_get_caps(m_sample))) {
+                m_info = info;
+            }
+        }
+
+        return m_info;
+    }
+
+    GstVideoFormat GetFormat() {
+        std::shared_ptr<const GstVideoInfo> info = GetVideoInfo();
+        return info ? GST_VIDEO_INFO_FORMAT(info.get()) : GST_VIDEO_FORMAT_UNKNOWN;
+    }
+
+    GstBuffer* GetBuffer() {
         if (!m_buffer) {
-            GstCaps* caps = gst_sample_get_caps(m_sample);
-            GstStructure* structure = gst_caps_get_structure(caps, 0);
-            gst_structure_get_int(structure, "width",  &m_cols);
-            gst_structure_get_int(structure, "height", &m_rows);
-            gst_structure_get_fraction(structure, "framerate", &m_fpsn, &m_fpsd);
-            m_format = gst_structure_get_string(structure, "format");
             m_buffer = gst_sample_get_buffer(m_sample);
         }
 
-        width  = m_cols;
-        height = m_rows;
-        format = m_format;
         return m_buffer;
     }
 
+    GstBuffer* GetBuffer(int& width, int& height, std::string& format) {
+        std::shared_ptr<const GstVideoInfo> info = GetVideoInfo();
+        if (info) {
+            width  = GST_VIDEO_INFO_WIDTH(info.get());
+            height = GST_VIDEO_INFO_HEIGHT(info.get());
+            format = gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(info.get()));
+        }
+
+        return GetBuffer();
+    }
+
     GstBuffer* RefBuffer(int& width, int& height, std::string& format) {
         return gst_buffer_ref(GetBuffer(width, height, format));
     }
@@ -125,14 +198,18 @@ private:
     GstSample* m_sample;
     GstBuffer* m_buffer;
 
-    int         m_cols;
-    int         m_rows;
-    int         m_fpsn;
-    int         m_fpsd;
-    const char* m_format;
+    std::shared_ptr<const GstVideoInfo> m_info;
     uint64_t    m_timestamp;
 };
 
+// pooled handles, no heap allocation per frame in steady state
+typedef SharedObjectPool<GstSampleObject> GstSampleObjectPool;
+
+// vectors come back cleared with their capacity, results don't allocate either
+typedef RecycledObjectPool<std::vector<OSDObject> > OSDResultPool;
+
+typedef SharedObjectPool<OSDResultBatch> OSDResultBatchPool;
+
 // callback functions
 typedef std::function<bool(GstSample* , void*)> PutFrameFunc;
 
@@ -142,4 +219,19 @@ typedef std::function<bool(std::shared_ptr<std::vector<OSDObject> >, void*)> Put
 
 typedef std::function<std::shared_ptr<std::vector<OSDObject> >(void*)> GetResultFunc;
 
-typedef std::function<void(GstBuffer* buffer, const std::shared_ptr<std::vector<OSDObject> >& results)> ProcResultFunc;
\ No newline at end of file
+typedef std::function<void(GstBuffer* buffer, const std::shared_ptr<std::vector<OSDObject> >& results)> ProcResultFunc;
+
+// PTS aware result callbacks, results are matched to the frame they were inferred on
+typedef std::function<bool(uint64_t pts, std::shared_ptr<std::vector<OSDObject> >, void*)> PutPtsResultFunc;
+
+typedef std::function<std::shared_ptr<std::vector<OSDObject> >(uint64_t pts, void*)> GetPtsResultFunc;
+
+// SoA result batch callbacks, the PTS of the inferred frame is carried by the batch
+typedef std::function<bool(std::shared_ptr<OSDResultBatch>, void*)> PutBatchResultFunc;
+
+typedef std::function<std::shared_ptr<OSDResultBatch>(uint64_t pts, void*)> GetBatchResultFunc;
+
+typedef std::function<void(GstBuffer* buffer, const std::shared_ptr<OSDResultBatch>& results)> ProcBatchResultFunc;
+
+// one of the inference outputs, called in the appsink thread, keep a copy of frame.image to hold it
+typedef std::function<void(const ScaledFrame& frame, uint64_t pts, void*)> PutScaledFrameFunc;
@@ -0,0 +1,256 @@
+/*
+ * @Description: Bounded delay of display frames waiting for their inference result.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 20:31:47
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 04:42:45
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "LatencyTracer.h"
+
+/**
+ * @brief Hold every display frame until the result inferred on it arrives
+ * or its deadline expires, whichever comes first.
+ *
+ * Frames are pushed when they enter the display branch, and waited for by
+ * the thread releasing them, so the branch split and the inference branch
+ * never wait. The deadline is the arrival plus a delay sized from the
+ * measured result latency, a percentile of the last WINDOW results, clamped
+ * to [min_delay, max_delay]. Until the first window is measured the delay
+ * is max_delay, so max_delay is the hard latency cap of the display. The
+ * sinks behind the delay line follow Delay() each time Notify() changes it.
+ */
+class DelayLine {
+public:
+    static const int WINDOW = 64;       /* results per delay update */
+    static const size_t CAPACITY = 512; /* frames in flight, more were dropped by a leaky queue */
+
+    /**
+     * @brief constructor
+     * @Author: Ricardo Lu
+     * @param[in] min_delay - ns, kept even if results arrive sooner.
+     * @param[in] max_delay - ns, 0 to disable.
+     * @param[in] percentile - of the result latency the delay covers.
+     */
+    DelayLine(int64_t min_delay = 0, int64_t max_delay = 0, double percentile = 95) :
+        m_minDelay  (min_delay < max_delay ? min_delay : max_delay),
+        m_maxDelay  (max_delay),
+        m_percentile(percentile > 0 && percentile <= 100 ? percentile : 95),
+        m_delay     (max_delay),
+        m_samples   (0),
+        m_waiting   (false),
+        m_waitPts   (0),
+        m_waitReady (false),
+        m_flushing  (false),
+        m_onResult  (0),
+        m_onDeadline(0) {
+
+    }
+
+    bool Enabled() const {
+        return m_maxDelay > 0;
+    }
+
+    /**
+     * @brief A frame entered the display branch.
+     * @Author: Ricardo Lu
+     * @param[in] pts - PTS of the frame in ns.
+     * @param[in] now - ns of std::chrono::steady_clock.
+     */
+    void Push(uint64_t pts, int64_t now) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_frames.push_back({ pts, now, false });
+        // frames dropped by a leaky queue are never waited for
+        while (m_frames.size() > CAPACITY) {
+            m_frames.pop_front();
+        }
+    }
+
+    /**
+     * @brief The result of a frame is ready, released at once if waited for.
+     * @Author: Ricardo Lu
+     * @param[in] pts - PTS of the inferred frame in ns.
+     * @param[in] now - ns of std::chrono::steady_clock.
+     * @return true if the result completed a window that changed Delay().
+     */
+    bool Notify(uint64_t pts, int64_t now) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        bool found = false;
+        bool changed = false;
+
+        // results are recent, look from the newest frame
+        for (auto it = m_frames.rbegin(); it != m_frames.rend(); ++it) {
+            if (it->pts != pts) {
+                continue;
+            }
+            if (!it->ready) {
+                it->ready = true;
+                changed = Measure(now - it->arrival);
+            }
+            found = true;
+            break;
+        }
+
+        // late results count too, the delay grows to cover them
+        for (auto it = m_late.begin(); !found && it != m_late.end(); ++it) {
+            if (it->pts == pts) {
+                changed = Measure(now - it->arrival);
+                m_late.erase(it);
+                break;
+            }
+        }
+
+        if (m_waiting && m_waitPts == pts) {
+            m_waitReady = true;
+            m_condition.notify_all();
+        }
+
+        return changed;
+    }
+
+    /**
+     * @brief Wait for the result of a frame leaving the display branch.
+     * @Author: Ricardo Lu
+     * @param[in] pts - PTS of the frame in ns.
+     * @return true if the result is ready, false on deadline, flush or an
+     * unknown frame.
+     */
+    bool Wait(uint64_t pts) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        size_t ahead = 0;
+        int64_t deadline;
+        bool ready;
+
+        // usually the oldest frame, the deque only holds frames in flight
+        while (ahead < m_frames.size() && m_frames[ahead].pts != pts) {
+            ahead++;
+        }
+        if (ahead == m_frames.size()) {
+            return false;
+        }
+
+        // frames pushed ahead of this one left the queue, released or dropped
+        while (ahead--) {
+            Retire();
+        }
+
+        if (m_frames.front().ready) {
+            m_frames.pop_front();
+            m_onResult++;
+            return true;
+        }
+
+        if (m_flushing) {
+            Retire();
+            return false;
+        }
+
+        deadline = m_frames.front().arrival + m_delay.load(std::memory_order_relaxed);
+        m_waiting = true;
+        m_waitPts = pts;
+        m_waitReady = false;
+        m_condition.wait_until(lock, std::chrono::steady_clock::time_point(
+            std::chrono::nanoseconds(deadline)), [this]() {
+                return m_waitReady || m_flushing;
+            });
+        m_waiting = false;
+        ready = m_waitReady;
+
+        // gone if Push() went over CAPACITY meanwhile
+        if (!m_frames.empty() && m_frames.front().pts == pts) {
+            Retire();
+        }
+
+        ready ? m_onResult++ : m_onDeadline++;
+        return ready;
+    }
+
+    /**
+     * @brief Release the waiting frame and never wait again, e.g. on exit.
+     * @Author: Ricardo Lu
+     */
+    void Flush() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_flushing = true;
+        m_condition.notify_all();
+    }
+
+    int64_t Delay() const {
+        return m_delay.load(std::memory_order_relaxed);
+    }
+
+    uint64_t ReleasedOnResult() const {
+        return m_onResult.load(std::memory_order_relaxed);
+    }
+
+    uint64_t ReleasedOnDeadline() const {
+        return m_onDeadline.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Frame {
+        uint64_t    pts;
+        int64_t     arrival;
+        bool        ready;
+    };
+
+    // m_mutex held, the oldest frame is released, its result may still come
+    void Retire() {
+        if (!m_frames.front().ready) {
+            m_late.push_back(m_frames.front());
+            if (m_late.size() > (size_t)WINDOW) {
+                m_late.pop_front();
+            }
+        }
+        m_frames.pop_front();
+    }
+
+    // m_mutex held, true if the delay changed
+    bool Measure(int64_t latency) {
+        m_latency.Record(latency);
+        if (++m_samples < WINDOW) {
+            return false;
+        }
+
+        int64_t delay = (int64_t)m_latency.Percentile(m_percentile) * 1000;
+        delay = delay < m_minDelay ? m_minDelay : delay;
+        delay = delay > m_maxDelay ? m_maxDelay : delay;
+
+        // the next window follows changes of the consumer
+        m_latency.Reset();
+        m_samples = 0;
+
+        return m_delay.exchange(delay, std::memory_order_relaxed) != delay;
+    }
+
+    const int64_t           m_minDelay;
+    const int64_t           m_maxDelay;
+    const double            m_percentile;
+    std::atomic<int64_t>    m_delay;            /* ns */
+
+    std::mutex              m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Frame>       m_frames;           /* in flight, oldest first */
+    std::deque<Frame>       m_late;             /* released before their result */
+    LatencyHistogram        m_latency;          /* us, of the current window */
+    int                     m_samples;
+    bool                    m_waiting;
+    uint64_t                m_waitPts;
+    bool                    m_waitReady;
+    bool                    m_flushing;
+
+    std::atomic<uint64_t>   m_onResult;
+    std::atomic<uint64_t>   m_onDeadline;
+};
@@ -0,0 +1,91 @@
+/*
+ * @Description: Pre-event recording of the encoded stream into MP4 clips.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 20:58:36
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 20:58:36
+ */
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gst/gst.h>
+#include <gst/app/app.h>
+
+/**
+ * @brief Keep the last pre_event of encoded H.264 in memory, as whole GOPs
+ * within max_bytes, and write it to an MP4 clip once an event is triggered.
+ *
+ * The clip goes on with the live stream until Stop(), or post_event after
+ * the last Trigger(). Clips are written by a pipeline of their own,
+ * appsrc ! h264parse ! mp4mux ! filesink, finalized in the background and
+ * torn down from the bus watch attached to context.
+ */
+class EventRecorder {
+public:
+    struct Recording {
+        EventRecorder*  recorder;
+        GstElement*     pipeline;
+        GstElement*     appsrc;
+        GSource*        bus_watch;
+        std::string     path;
+    };
+
+    /**
+     * @brief constructor
+     * @Author: Ricardo Lu
+     * @param[in] pre_event - ns kept ahead of a trigger, rounded up to GOPs.
+     * @param[in] post_event - ns recorded after the last trigger, 0 until Stop().
+     * @param[in] max_bytes - memory budget of the ring, oldest GOPs go first.
+     * @param[in] context - of the bus watches, nullptr for the default one.
+     */
+    EventRecorder(GstClockTime pre_event, GstClockTime post_event,
+        size_t max_bytes, GMainContext* context);
+   ~EventRecorder();
+
+    EventRecorder(const EventRecorder&) = delete;
+    EventRecorder& operator=(const EventRecorder&) = delete;
+
+    void SetCaps       (GstCaps* caps);
+    void Push          (GstBuffer* buffer);
+    bool Trigger       (const std::string& path);
+    void Stop          ();
+    void Reset         ();
+    void Release       (Recording* recording);
+    GstClockTime Buffered();
+
+private:
+    struct Gop {
+        GstClockTime            start;
+        size_t                  bytes;
+        std::vector<GstBuffer*> buffers;
+    };
+
+    GstClockTime BufferedLocked();
+    void PopGopLocked  ();
+    void PushLocked    (GstBuffer* buffer);
+    void FinishLocked  ();
+    void CloseLocked   (Recording* recording);
+
+    const GstClockTime      m_preEvent;
+    const GstClockTime      m_postEvent;
+    const size_t            m_maxBytes;
+    GMainContext*           m_context;
+
+    std::mutex              m_mutex;
+    GstCaps*                m_caps;
+    std::deque<Gop>         m_gops;         /* each starts at a keyframe */
+    size_t                  m_bytes;
+    GstClockTime            m_lastTs;       /* DTS, or PTS, of the newest buffer */
+    bool                    m_overBudget;   /* warned once */
+
+    Recording*              m_active;       /* clip taking the live stream */
+    std::vector<Recording*> m_finishing;    /* EOS sent, waiting for mp4mux */
+    GstClockTime            m_stopTs;       /* end of m_active, NONE until Stop() */
+    GstClockTime            m_base;         /* first timestamp of m_active */
+    bool                    m_waitKey;      /* m_active starts at a keyframe */
+};
@@ -0,0 +1,136 @@
+/*
+ * @Description: Frame admission control of the inference branch.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 17:48:12
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 04:31:00
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Decide which frames enter the inference branch, so frames the
+ * model would never see are dropped before color conversion.
+ *
+ * Frames are spaced by PTS, at most target_fps, and in adaptive mode at most
+ * headroom times the rate the consumer reports through OnConsumed(). The
+ * consumer rate is measured between two completions, idle time included,
+ * so the admitted rate keeps probing upwards by the headroom until the
+ * consumer becomes the bottleneck.
+ */
+class InferenceRateController {
+public:
+    static constexpr uint64_t NONE = UINT64_MAX;
+
+    /**
+     * @brief constructor
+     * @Author: Ricardo Lu
+     * @param[in] target_fps - Max inference rate, 0 for no fixed limit.
+     * @param[in] adaptive - Follow the measured consumer throughput.
+     * @param[in] headroom - Admit this much faster than the consumer drains.
+     */
+    InferenceRateController(double target_fps = 0, bool adaptive = false,
+        double headroom = 1.1) :
+        m_targetInterval(target_fps > 0 ? (int64_t)(1e9 / target_fps) : 0),
+        m_adaptive      (adaptive),
+        m_headroom      (headroom > 1.0 ? headroom : 1.0),
+        m_nextPts       (NONE),
+        m_lastPts       (NONE),
+        m_lastConsumed  (0),
+        m_consumerInterval(0),
+        m_admitted      (0),
+        m_dropped       (0) {
+
+    }
+
+    bool Enabled() const {
+        return m_targetInterval > 0 || m_adaptive;
+    }
+
+    /**
+     * @brief Called in the streaming thread for every frame of the branch.
+     * @Author: Ricardo Lu
+     * @param[in] pts - PTS of the frame in ns.
+     * @return true if the frame should be inferred.
+     */
+    bool Admit(uint64_t pts) {
+        int64_t interval = m_targetInterval;
+
+        if (m_adaptive) {
+            int64_t consumer = (int64_t)(m_consumerInterval.load() / m_headroom);
+            interval = consumer > interval ? consumer : interval;
+        }
+
+        // no timing information, or restarted after a seek or a loop
+        if (pts == NONE || interval <= 0) {
+            m_admitted++;
+            return true;
+        }
+        if (m_lastPts != NONE && pts < m_lastPts) {
+            m_nextPts = NONE;
+        }
+        m_lastPts = pts;
+
+        if (m_nextPts != NONE && pts < m_nextPts) {
+            m_dropped++;
+            return false;
+        }
+
+        // keep the cadence unless the stream jumped ahead
+        m_nextPts = (m_nextPts != NONE && pts - m_nextPts < (uint64_t)interval) ?
+            m_nextPts + interval : pts + interval;
+        m_admitted++;
+        return true;
+    }
+
+    /**
+     * @brief Called through VideoPipeline::OnInferenceDone() each time the
+     * consumer finished a frame.
+     * @Author: Ricardo Lu
+     */
+    void OnConsumed() {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t last = m_lastConsumed.exchange(now);
+
+        if (last > 0) {
+            int64_t ewma = m_consumerInterval.load();
+            m_consumerInterval.store(ewma ? (ewma * 7 + (now - last)) / 8 : now - last);
+        }
+    }
+
+    void Reset() {
+        m_nextPts = NONE;
+        m_lastPts = NONE;
+        m_lastConsumed.store(0);
+        m_consumerInterval.store(0);
+    }
+
+    double ConsumerFps() const {
+        int64_t interval = m_consumerInterval.load();
+        return interval > 0 ? 1e9 / interval : 0;
+    }
+
+    uint64_t Admitted() const { return m_admitted.load(); }
+    uint64_t Dropped() const { return m_dropped.load(); }
+
+private:
+    const int64_t           m_targetInterval;   /* ns between frames of target fps */
+    const bool              m_adaptive;
+    const double            m_headroom;
+
+    // streaming thread only
+    uint64_t                m_nextPts;
+    uint64_t                m_lastPts;
+
+    // consumer thread writes, streaming thread reads
+    std::atomic<int64_t>    m_lastConsumed;
+    std::atomic<int64_t>    m_consumerInterval; /* EWMA of ns between completions */
+
+    std::atomic<uint64_t>   m_admitted;
+    std::atomic<uint64_t>   m_dropped;
+};
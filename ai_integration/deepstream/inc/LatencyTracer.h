@@ -0,0 +1,216 @@
+/*
+ * @Description: Per-frame latency from decoder output to the branch sinks.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 18:31:02
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 18:31:02
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <gst/gst.h>
+
+/* GstLatencyMeta - monotonic time the frame left the decoder
+ * stamp: ns of std::chrono::steady_clock
+ */
+typedef struct _GstLatencyMeta {
+    GstMeta             meta;
+    int64_t             stamp;
+} GstLatencyMeta;
+
+GType gst_latency_meta_api_get_type(void);
+const GstMetaInfo* gst_latency_meta_get_info(void);
+
+#define GST_LATENCY_META_API_TYPE       (gst_latency_meta_api_get_type())
+#define GST_LATENCY_META_INFO           (gst_latency_meta_get_info())
+
+#define gst_buffer_get_latency_meta(b)  \
+    ((GstLatencyMeta*)gst_buffer_get_meta((b), GST_LATENCY_META_API_TYPE))
+
+GstLatencyMeta* gst_buffer_add_latency_meta(GstBuffer* buffer, int64_t stamp);
+
+/**
+ * @brief Lock-free log-linear histogram of latencies in us, 8 buckets per
+ * power of two, so a percentile is off by at most 12.5%.
+ */
+class LatencyHistogram {
+public:
+    static const int LINEAR = 16;       /* exact below 16us */
+    static const int SUB_BUCKETS = 8;
+    static const int BUCKETS = LINEAR + (64 - 4) * SUB_BUCKETS;
+
+    LatencyHistogram() {
+        Reset();
+    }
+
+    void Record(int64_t ns) {
+        uint64_t us = ns > 0 ? (uint64_t)ns / 1000 : 0;
+
+        m_buckets[Index(us)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (us > max && !m_max.compare_exchange_weak(max, us,
+            std::memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * @brief Upper bound of the bucket holding the given percentile.
+     * @Author: Ricardo Lu
+     * @param[in] percentile - in (0, 100].
+     * @return latency in us, 0 if nothing recorded.
+     */
+    uint64_t Percentile(double percentile) const {
+        uint64_t counts[BUCKETS];
+        uint64_t total = 0;
+
+        // buckets keep moving, percentiles are taken over this very copy
+        for (int i = 0; i < BUCKETS; i++) {
+            counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (!total) {
+            return 0;
+        }
+
+        uint64_t rank = (uint64_t)(percentile / 100.0 * total + 0.5);
+        rank = rank ? rank : 1;
+
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            if ((seen += counts[i]) >= rank) {
+                uint64_t upper = UpperBound(i);
+                uint64_t max = Max();
+                return upper < max ? upper : max;
+            }
+        }
+
+        return Max();
+    }
+
+    uint64_t Max() const {
+        return m_max.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Count() const {
+        return m_count.load(std::memory_order_relaxed);
+    }
+
+    void Reset() {
+        for (int i = 0; i < BUCKETS; i++) {
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+        m_count.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static int Index(uint64_t us) {
+        if (us < LINEAR) {
+            return (int)us;
+        }
+
+        int octave = 63 - __builtin_clzll(us);  /* >= 4 */
+        int sub = (int)(us >> (octave - 3)) & (SUB_BUCKETS - 1);
+        return LINEAR + (octave - 4) * SUB_BUCKETS + sub;
+    }
+
+    static uint64_t UpperBound(int index) {
+        if (index < LINEAR) {
+            return index;
+        }
+
+        int octave = (index - LINEAR) / SUB_BUCKETS + 4;
+        int sub = (index - LINEAR) % SUB_BUCKETS;
+        return ((uint64_t)(SUB_BUCKETS + sub + 1) << (octave - 3)) - 1;
+    }
+
+    std::atomic<uint64_t>   m_buckets[BUCKETS];
+    std::atomic<uint64_t>   m_count;
+    std::atomic<uint64_t>   m_max;
+};
+
+typedef enum _LatencyBranch {
+    LATENCY_DISPLAY = 0,            /* decoder -> nveglglessink */
+    LATENCY_RTMP,                   /* decoder -> nvv4l2h264enc */
+    LATENCY_INFERENCE,              /* decoder -> appsink pulled */
+    LATENCY_BRANCH_NUM
+}LatencyBranch;
+
+/* latencies in us */
+typedef struct _LatencyStats {
+    uint64_t    count;
+    uint64_t    p50;
+    uint64_t    p95;
+    uint64_t    p99;
+    uint64_t    max;
+}LatencyStats;
+
+class LatencyTracer {
+public:
+    static int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static const char* BranchName(LatencyBranch branch) {
+        static const char* names[LATENCY_BRANCH_NUM] = { "display", "rtmp", "inference" };
+        return names[branch];
+    }
+
+    /**
+     * @brief Stamp the buffer unless it's stamped already.
+     * @Author: Ricardo Lu
+     * @param[in] buffer - may be replaced by a writable copy.
+     * @return the stamped buffer.
+     */
+    static GstBuffer* Stamp(GstBuffer* buffer) {
+        if (gst_buffer_get_latency_meta(buffer)) {
+            return buffer;
+        }
+
+        buffer = gst_buffer_make_writable(buffer);
+        gst_buffer_add_latency_meta(buffer, Now());
+        return buffer;
+    }
+
+    /**
+     * @brief Record the latency of a buffer reaching the end of a branch,
+     * buffers rebuilt by a muxer or tiler carry no stamp and are skipped.
+     * @Author: Ricardo Lu
+     */
+    void Record(LatencyBranch branch, GstBuffer* buffer) {
+        GstLatencyMeta* meta = gst_buffer_get_latency_meta(buffer);
+
+        if (meta) {
+            m_histograms[branch].Record(Now() - meta->stamp);
+        }
+    }
+
+    LatencyStats Query(LatencyBranch branch) const {
+        const LatencyHistogram& histogram = m_histograms[branch];
+        LatencyStats stats;
+
+        stats.count = histogram.Count();
+        stats.p50 = histogram.Percentile(50);
+        stats.p95 = histogram.Percentile(95);
+        stats.p99 = histogram.Percentile(99);
+        stats.max = histogram.Max();
+
+        return stats;
+    }
+
+    void Reset() {
+        for (int i = 0; i < LATENCY_BRANCH_NUM; i++) {
+            m_histograms[i].Reset();
+        }
+    }
+
+private:
+    LatencyHistogram        m_histograms[LATENCY_BRANCH_NUM];
+};
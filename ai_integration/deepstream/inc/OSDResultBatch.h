@@ -0,0 +1,149 @@
+/*
+ * @Description: Structure-of-arrays inference result batch.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 15:58:03
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 15:58:03
+ */
+#pragma once
+
+#include <memory>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+
+/**
+ * @brief Bump allocator over one aligned memory block, every array handed
+ * out is aligned for SIMD loads and the whole block is freed at once.
+ */
+class FrameArena {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    FrameArena(size_t size) : m_offset(0) {
+        m_size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        m_data = static_cast<uint8_t*>(aligned_alloc(ALIGNMENT, m_size ? m_size : ALIGNMENT));
+        if (!m_data) {
+            throw std::bad_alloc();
+        }
+    }
+
+   ~FrameArena() {
+        free(m_data);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    template<typename T>
+    T* Allocate(size_t count) {
+        size_t bytes = (count * sizeof(T) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (m_offset + bytes > m_size) {
+            return nullptr;
+        }
+
+        T* p = reinterpret_cast<T*>(m_data + m_offset);
+        m_offset += bytes;
+        return p;
+    }
+
+    void Reset() {
+        m_offset = 0;
+    }
+
+    static size_t Footprint(size_t count, size_t elem_size) {
+        return (count * elem_size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+private:
+    uint8_t* m_data;
+    size_t   m_size;
+    size_t   m_offset;
+};
+
+/**
+ * @brief Inference results of one frame laid out as structure of arrays,
+ * so OSD and serialization walk each field with contiguous, vectorizable
+ * loops. All arrays are carved out of a single per-batch FrameArena and
+ * reused across frames by Clear(), e.g. together with SharedObjectPool.
+ */
+class OSDResultBatch {
+public:
+    OSDResultBatch(size_t capacity, uint64_t pts = 0) :
+        m_arena(4 * FrameArena::Footprint(capacity, sizeof(int16_t)) +
+                FrameArena::Footprint(capacity, sizeof(uint32_t)) +
+                FrameArena::Footprint(capacity, sizeof(uint16_t)) +
+                FrameArena::Footprint(capacity, sizeof(float))),
+        m_capacity(capacity),
+        m_size    (0),
+        pts       (pts) {
+            x          = m_arena.Allocate<int16_t>(capacity);
+            y          = m_arena.Allocate<int16_t>(capacity);
+            width      = m_arena.Allocate<int16_t>(capacity);
+            height     = m_arena.Allocate<int16_t>(capacity);
+            rgba       = m_arena.Allocate<uint32_t>(capacity);
+            label      = m_arena.Allocate<uint16_t>(capacity);
+            confidence = m_arena.Allocate<float>(capacity);
+        }
+
+    /**
+     * @brief Pack a colour with components in [0, 1] into 0xRRGGBBAA.
+     */
+    static uint32_t PackRGBA(double r, double g, double b, double a = 1.0) {
+        auto channel = [](double c) -> uint32_t {
+            return c <= 0.0 ? 0 : c >= 1.0 ? 255 : (uint32_t)(c * 255.0 + 0.5);
+        };
+        return (channel(r) << 24) | (channel(g) << 16) | (channel(b) << 8) | channel(a);
+    }
+
+    /**
+     * @brief Append a box.
+     * @return false if the batch is full.
+     */
+    bool Add(int _x, int _y, int _width, int _height, uint32_t _rgba,
+        uint16_t _label = 0, float _confidence = 1.0f) {
+        if (m_size == m_capacity) {
+            return false;
+        }
+
+        x[m_size]          = (int16_t)_x;
+        y[m_size]          = (int16_t)_y;
+        width[m_size]      = (int16_t)_width;
+        height[m_size]     = (int16_t)_height;
+        rgba[m_size]       = _rgba;
+        label[m_size]      = _label;
+        confidence[m_size] = _confidence;
+        m_size++;
+        return true;
+    }
+
+    void Clear(uint64_t _pts = 0) {
+        m_size = 0;
+        pts = _pts;
+    }
+
+    size_t Size() const {
+        return m_size;
+    }
+
+    size_t Capacity() const {
+        return m_capacity;
+    }
+
+private:
+    FrameArena m_arena;
+    size_t     m_capacity;
+    size_t     m_size;
+
+public:
+    uint64_t   pts;         /* PTS of the inferred frame */
+    int16_t*   x;
+    int16_t*   y;
+    int16_t*   width;
+    int16_t*   height;
+    uint32_t*  rgba;        /* 0xRRGGBBAA */
+    uint16_t*  label;       /* class id */
+    float*     confidence;
+};
@@ -0,0 +1,81 @@
+/*
+ * @Description: Run many VideoPipeline instances in one process.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 17:20:45
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 04:44:19
+ */
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "VideoPipeline.h"
+
+// called on every newly created VideoPipeline before Create(), e.g. to set its callbacks
+typedef std::function<void(VideoPipeline*)> PipelineSetupFunc;
+
+class PipelineManager {
+public:
+    PipelineManager    ();
+    ~PipelineManager   ();
+    bool Add           (VideoPipelineConfig config);
+    bool Bind          (VideoPipelineConfig config);
+    bool Remove        (const std::string& id);
+    bool Start         (const std::string& id);
+    void Stop          (const std::string& id);
+    bool Restart       (const std::string& id);
+    void ScheduleRestart(const std::string& id);
+    void SetRestartPolicy(int interval, int max_interval, int max_attempts);
+    bool StartAll      ();
+    void StopAll       ();
+    void Run           ();
+    void Quit          ();
+    void SetCallbacks  (PipelineSetupFunc func);
+    bool SetWarmPool   (const VideoPipelineConfig& config, size_t size);
+    void RefillStandby ();
+    VideoPipeline* Get (const std::string& id);
+    size_t Size        ();
+
+    struct PipelineEntry {
+        PipelineManager*    manager;
+        VideoPipelineConfig config;
+        VideoPipeline*      pipeline;       /* nullptr while stopped */
+        GSource*            bus_watch;      /* attached to the shared context */
+        int                 restart_count;  /* since the last run that got a frame */
+        GSource*            restart_source; /* pending restart or give-up stop */
+        uint64_t            restart_token;  /* of the restart building, 0 once stopped */
+    };
+
+private:
+    std::string UniqueIdLocked(const std::string& id);
+    bool StartLocked   (PipelineEntry* entry);
+    void StopLocked    (PipelineEntry* entry);
+    void CancelRestartLocked(PipelineEntry* entry);
+    void ScheduleRestartLocked(PipelineEntry* entry);
+    void WatchLocked   (PipelineEntry* entry);
+
+public:
+    GMainContext*       m_context;          /* shared by every pipeline */
+    GMainLoop*          m_loop;
+    PipelineSetupFunc   m_setupFunc;
+    uint32_t            m_nextId;           /* for pipelines without unique name */
+    uint32_t            m_nextStandby;
+
+    // restart on error: interval << attempts, capped, then the pipeline is stopped //
+    int                 m_restartInterval;      /* ms */
+    int                 m_restartMaxInterval;   /* ms */
+    int                 m_restartMaxAttempts;   /* 0 for no limit */
+    uint64_t            m_restartToken;
+
+    // warm pool: created and READY, waiting for Bind() //
+    VideoPipelineConfig m_standbyConfig;    /* template of standby pipelines, no uri */
+    size_t              m_standbySize;
+    bool                m_refillPending;
+    std::vector<std::unique_ptr<PipelineEntry> > m_standby;
+
+    std::mutex          m_mutex;            /* guard of m_pipelines and m_standby */
+    std::map<std::string, std::unique_ptr<PipelineEntry> > m_pipelines;
+};
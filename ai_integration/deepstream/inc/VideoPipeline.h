@@ -4,13 +4,16 @@
  * @Author: Ricardo Lu<shenglu1202@163.com>
  * @Date: 2022-07-15 22:07:29
  * @LastEditors: Ricardo Lu
- * @LastEditTime: 2023-02-06 21:03:47
+ * @LastEditTime: 2026-10-18 04:42:45
  */
 #pragma once
 
 # include "Common.h"
-
-static int pipeline_id = 0;
+# include "Backend.h"
+# include "InferenceRateController.h"
+# include "LatencyTracer.h"
+# include "DelayLine.h"
+# include "EventRecorder.h"
 
 typedef enum _VideoType {
     FILE_STREAM = 0,
@@ -18,14 +21,59 @@ typedef enum _VideoType {
     USB_CAMERE = 2
 }VideoType;
 
+typedef struct _VideoSourceConfig {
+    int         source_id;          /* pad sink_%u of the muxer, reported in batch meta */
+    std::string src_uri;
+}VideoSourceConfig;
+
+/* per-source frame of a batched buffer */
+typedef struct _BatchFrameInfo {
+    uint32_t    source_id;
+    uint32_t    batch_index;        /* index of the frame in the batched buffer */
+    uint64_t    pts;                /* original PTS of the source frame */
+    int         width;              /* original resolution of the source frame */
+    int         height;
+    GstBuffer*  buffer;             /* source frame of cpubatchmux, nullptr for nvstreammux */
+}BatchFrameInfo;
+
+/* branches that can be attached and detached while PLAYING */
+typedef enum _OutputBranch {
+    DISPLAY_BRANCH = 0,             /* tee1 -> queue10 -> nveglglessink */
+    RTMP_BRANCH,                    /* tee1 -> queue11 -> ... -> rtmpsink */
+    INFERENCE_BRANCH,               /* tee0 -> queue01 -> ... -> appsink */
+    OUTPUT_BRANCH_NUM
+}OutputBranch;
+
+/* queue at the head of a branch, defaults are the ones of GstQueue */
+typedef struct _QueueConfig {
+    guint       max_buffers { 200 };        /* 0 for unlimited */
+    guint       max_bytes { 10485760 };
+    guint64     max_time { GST_SECOND };    /* ns */
+    int         leaky { 0 };                /* GstQueueLeaky, 0: no, 1: upstream, 2: downstream */
+}QueueConfig;
+
 typedef struct _VideoPipelineConfig {
     std::string pipeline_id;
+    BackendType backend { BACKEND_NVIDIA };     /* elements of decoder, converter, encoder and display */
     int         input_type { VideoType::FILE_STREAM };
     /*------------------uridecodebin------------------*/
     std::string src_uri;
     bool        file_loop;
+    bool        gapless_loop { false };     /* loop by segment seeks, no flush or state change */
     int         rtsp_latency;
     int         rtp_protocol;
+    // rtsp only, rebuild uridecodebin on errors or stalls, with backoff //
+    int         reconnect_timeout { 0 };        /* ms without buffers, 0 to disable */
+    int         reconnect_interval { 500 };     /* ms before the first attempt, doubled after */
+    int         reconnect_max_interval { 16000 };
+    /*--------------------streammux--------------------*/
+    // batching mode if not empty, every source is an uridecodebin //
+    std::vector<VideoSourceConfig> batch_sources;
+    std::string batch_muxer { "nvstreammux" };  /* nvstreammux or cpubatchmux */
+    int         batch_width { 1920 };           /* output resolution of nvstreammux */
+    int         batch_height { 1080 };
+    int         batch_timeout { 40000 };        /* batched-push-timeout in us */
+    bool        batch_live_source { false };
     /*--------------------v4l2src--------------------*/
     std::string src_device;
     std::string src_format;
@@ -33,7 +81,14 @@ typedef struct _VideoPipelineConfig {
     int         src_height;
     int         src_framerate_n;
     int         src_framerate_d;
+    /*-------------------branch queues-------------------*/
+    // a leaky queue drops on its own instead of blocking tee0/tee1 //
+    QueueConfig queue00;                    /* display & rtmp, ahead of tee1 */
+    QueueConfig queue01;                    /* inference */
+    QueueConfig queue10;                    /* display */
+    QueueConfig queue11;                    /* rtmp */
     /*-------------nveglglessink branch-------------*/
+    // enable_* are the branches linked by Create(), then follow Attach/DetachBranch() //
     bool        enable_hdmi;
     bool        hdmi_sync;
     int         window_x;
@@ -46,39 +101,104 @@ typedef struct _VideoPipelineConfig {
     int         enc_bitrate;
     int         enc_iframe_interval;
     std::string rtmp_uri;
+    bool        rtmp_passthrough { false };     /* push the parsed H.264 of uridecodebin, no OSD, no encode */
     /*---------------inference branch---------------*/
     bool        enable_appsink;
+    int         sample_pool_size { 16 };    /* max alive pooled GstSampleObject */
+    double      infer_fps { 0 };            /* max frames into inference, 0 for all */
+    bool        adaptive_infer { false };   /* follow throughput the consumer reports by OnInferenceDone() */
+    guint       appsink_max_buffers { 4 };  /* 0 for unlimited */
+    bool        appsink_drop { false };     /* drop old samples instead of blocking when full */
+    bool        appsink_wait_on_eos { true };
+    std::vector<ScaleOutputConfig> infer_outputs;  /* single source only, on nvidia appsink gets frames scaled down for them */
     /*----------------nvvideoconvert----------------*/
     int         cvt_memory_type;
     std::string cvt_format;
-    int         cvt_width;
-    int         cvt_height;
-    std::string crop;
+    int         cvt_width { 0 };        /* scale to, 0 to keep the size */
+    int         cvt_height { 0 };
+    std::string crop;                   /* left:top:width:height of the source, inference only */
+    /*-----------------latency trace-----------------*/
+    // stamp frames at decoder output, measure at the end of every branch //
+    bool        enable_latency_trace { false };
+    int         latency_dump_interval { 0 };    /* s, 0 for no periodic dump */
+    /*----------------osd delay line----------------*/
+    // display frames wait for their result, released on OnResult() or the deadline //
+    int         osd_max_delay { 0 };        /* ms, latency cap of display and rtmp, 0 to disable */
+    int         osd_min_delay { 0 };        /* ms */
+    double      osd_delay_percentile { 95 };    /* of the result latency the delay covers */
+    /*----------------event recording----------------*/
+    // encoded H.264 of the rtmp branch, written to MP4 by TriggerRecord() //
+    bool        enable_record { false };
+    int         record_pre_event { 10 };    /* s kept ahead of an event, whole GOPs */
+    int         record_post_event { 10 };   /* s after the last trigger, 0 until StopRecord() */
+    int         record_max_bytes { 32 << 20 };  /* memory budget of the pre-event */
 }VideoPipelineConfig;
 
 class VideoPipeline {
 public:
-    VideoPipeline      (const VideoPipelineConfig& config);
+    VideoPipeline      (const VideoPipelineConfig& config, GMainContext* context = nullptr);
     ~VideoPipeline     ();
     bool Create        ();
+    bool Warm          ();
+    bool BindSource    (const std::string& id, const std::string& uri);
     bool Start         ();
     bool Pause         ();
     bool Resume        ();
     void Destroy       ();
     void SetCallbacks  (PutFrameFunc func, void* args);
     void SetCallbacks  (GetResultFunc func, void* args);
+    void SetCallbacks  (GetPtsResultFunc func, void* args);
+    void SetCallbacks  (GetBatchResultFunc func, void* args);
     void SetCallbacks  (ProcResultFunc func);
+    void SetCallbacks  (ProcBatchResultFunc func);
+    bool SetCallbacks  (const std::string& output, PutScaledFrameFunc func, void* args);
+    bool SetCrop       (const std::string& crop);
+    cv::Rect GetCrop   ();
+    void ApplyCrop     ();
+    bool ScaleOutputs  (GstSample* sample);
+    std::shared_ptr<GstSampleObject> MakeSampleObject(GstSample* sample, uint64_t timestamp);
+    static bool GetBatchFrames(GstBuffer* buffer, std::vector<BatchFrameInfo>& frames);
+    LatencyStats GetLatencyStats(LatencyBranch branch);
+    bool PassthroughEnabled();
+    bool ReconnectEnabled  ();
+    void ScheduleReconnect (const std::string& reason);
+    bool RebuildSource     ();
+    void DumpLatency   ();
+    int64_t GetTimeToFirstFrame();
+    void OnResult      (uint64_t pts);
+    void ApplyOsdDelay ();
+    void OnInferenceDone();
+    bool TriggerRecord (const std::string& path);
+    void StopRecord    ();
+    bool AttachBranch  (OutputBranch branch);
+    bool DetachBranch  (OutputBranch branch);
+    static const char* BranchName(OutputBranch branch);
 
 private:
-    GstElement* CreateUridecodebin();
+    bool CreateDisplayBranch();
+    bool CreateRtmpBranch();
+    bool CreateInferenceBranch();
+    bool LinkBranch(GstElement* tee, const std::vector<GstElement*>& elements);
+    std::vector<GstElement*> BranchElements(OutputBranch branch);
+    void ClearBranch(OutputBranch branch);
+    GstElement* CreateUridecodebin(const std::string& uri, int index);
     GstElement* CreateV4l2src();
+    GstElement* CreateStreammux();
+    void EnableReconnect();
+    void ApplyPrescale(const cv::Size& ref);
 
 public:
     PutFrameFunc        m_putFrameFunc;
     void*               m_putFrameArgs;
     GetResultFunc       m_getResultFunc;
     void*               m_getResultArgs;
+    GetPtsResultFunc    m_getPtsResultFunc;
+    void*               m_getPtsResultArgs;
+    GetBatchResultFunc  m_getBatchResultFunc;
+    void*               m_getBatchResultArgs;
     ProcResultFunc      m_procResultFunc;
+    ProcBatchResultFunc m_procBatchResultFunc;
+    std::vector<std::pair<PutScaledFrameFunc, void*> > m_scaledFrameFuncs; /* per infer_outputs */
 
 
     uint64_t            m_queue00_src_probe;     /* probe for nvvideoconvert sync ans osd process */
@@ -88,28 +208,74 @@ public:
 
     uint64_t            m_prev_accumulated_base;    /* PTS offset for seek */
     uint64_t            m_accumulated_base;         /* PTS offset for seek */
+    int64_t             m_loopOffset;               /* gapless loop: base - start of the segment, streaming thread */
+    std::atomic<bool>   m_loopSeeking;              /* gapless loop: segment seek scheduled */
+    std::atomic<bool>   m_loopArmed;                /* gapless loop: playing as a segment */
+    GSource*            m_segmentSeekSource;        /* pending segment seek, guarded by m_mutex */
 
     VideoPipelineConfig m_config;
+    const BackendProfile* m_backend;        /* profile of m_config.backend */
+    GMainContext*       m_context;          /* context of the pipeline timers, nullptr for the default one */
+    VideoInfoCache      m_videoInfoCache;   /* parsed caps of appsink samples, pass to GstSampleObject */
+    GstSampleObjectPool m_samplePool;       /* pooled GstSampleObject handles */
+    std::atomic<uint64_t> m_queue00_dropped;    /* buffers dropped by leaky queues */
+    std::atomic<uint64_t> m_queue01_dropped;
+    std::atomic<uint64_t> m_queue10_dropped;
+    std::atomic<uint64_t> m_queue11_dropped;
+    InferenceRateController m_rateController;   /* consumer calls OnConsumed() per inferred frame */
+    MultiScaler         m_multiScaler;      /* infer_outputs, appsink thread only */
+    std::vector<ScaledFrame> m_scaledFrames;
+    DelayLine           m_delayLine;        /* display frames waiting for results, thread of queue00 */
+    GSource*            m_osdDelaySource;   /* pending ApplyOsdDelay(), guarded by m_mutex */
+    std::unique_ptr<EventRecorder> m_recorder;  /* fed by h264parse0, enable_record only */
+    LatencyTracer       m_latencyTracer;
+    GSource*            m_latencyDumpSource;    /* periodic dump of m_latencyTracer */
+    std::atomic<int64_t> m_lastBufferTime;      /* us, monotonic, last buffer into tee0 */
+    std::atomic<int>    m_reconnectAttempts;    /* since the last buffer */
+    GSource*            m_watchdogSource;
+    GSource*            m_reconnectSource;      /* pending rebuild, guarded by m_mutex */
+    int64_t             m_startTime;            /* us, monotonic, Create() or BindSource() */
+    std::atomic<int64_t> m_timeToFirstFrame;    /* us, -1 until the first buffer into tee0 */
+    bool                m_warmStart;            /* bound to a standby pipeline */
+    // rtmp passthrough, streaming thread of the parser only //
+    bool                m_passthroughH264;
+    bool                m_passthroughNewSegment;
+    bool                m_passthroughWaitKey;       /* dropped, resume from a keyframe */
+    GstSegment          m_passthroughSegment;       /* of the parsed stream */
+    GstClockTime        m_passthroughBase;          /* keeps DTS going on across restarts */
+    GstClockTime        m_passthroughLastDts;
+    // inference crop, guarded by m_cropMutex //
+    std::mutex          m_cropMutex;
+    cv::Rect            m_crop;             /* requested, empty for the whole frame */
+    cv::Rect            m_cropApplied;      /* clamped to the frame */
+    int                 m_cropFrameWidth;   /* of the frames into the crop, 0 until negotiated */
+    int                 m_cropFrameHeight;
+    // nvidia: nvvideoconvert1 scales down for infer_outputs, MultiScaler finishes //
+    bool                m_inferPrescale;
+    cv::Size            m_inferSize;        /* set on capfilter2, empty for the cropped size */
+    cv::Size            m_inferRef;         /* cropped size the scaled frames stand for */
 
     volatile int        m_syncCount;
     volatile bool       m_isExited;
     GMutex              m_syncMuxtex;
     GCond               m_syncCondition;
-    GMutex              m_mutex;
+    GMutex              m_mutex;            /* also serializes Attach/DetachBranch() */
     bool                m_dumped;           /* dump pipeline to dot */
 
     GstElement*         m_pipeline;
     GstElement*         m_source;           /* uridecodebin or v4l2src */
-    GstElement*         m_streammuxer;      /* nvstreamuxer */
+    GstElement*         m_streammuxer;      /* nvstreammux or cpubatchmux */
+    GstElement*         m_tiler;            /* nvmultistreamtiler, batch to display */
     GstElement*         m_capfilter0;        /* image/jpeg */
     GstElement*         m_decoder;          /* nvv4l2decoder or nvjpegdec */
     GstElement*         m_tee0;             /* display branch & inference branch */
     GstElement*         m_queue00;          /* for display branch */ 
-    GstElement*         m_fakesink;         /* sync stream when disabled display */
-    GstElement*         m_tee1;             /* nveglglessink branch & rtmpsink branch */
+    GstElement*         m_fakesink;         /* sync stream when created without display and rtmp */
+    GstElement*         m_tee1;             /* nveglglessink branch & rtmpsink branch, none with cpubatchmux */
     GstElement*         m_queue10;          /* for nveglglessink branch */
     GstElement*         m_nveglglessink;    /* nveglglessink */
     GstElement*         m_queue11;          /* for rtmpsink branch */
+    GstElement*         m_rtmpsrc;          /* appsrc, head of rtmpsink branch in passthrough */
     GstElement*         m_nvvideoconvert0;  /* convert RGBA(nvjpegdec) to NV12 */
     GstElement*         m_capfilter1;
     GstElement*         m_encoder;          /* nvv4l2h264enc */
@@ -117,7 +283,9 @@ public:
     GstElement*         m_flvmux;           /* flvmux */
     GstElement*         m_rtmpsink;         /* rtmpsink */
     GstElement*         m_queue01;          /* for inference branch */
+    GstElement*         m_videocrop;        /* crop ahead of converters without src-crop */
     GstElement*         m_nvvideoconvert1;  /* convert NV12(nvv4l2decoder) to RGBA */
+    GstElement*         m_videoscale;       /* software backend, videoconvert keeps the size */
     GstElement*         m_capfilter2;
     GstElement*         m_appsink;          /* for AI inference */
 };
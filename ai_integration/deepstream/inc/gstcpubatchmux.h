@@ -0,0 +1,86 @@
+/*
+ * @Description: CPU stand-in of nvstreammux.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 16:24:10
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 16:24:10
+ */
+
+#ifndef __GST_CPU_BATCH_MUX_H__
+#define __GST_CPU_BATCH_MUX_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstaggregator.h>
+
+G_BEGIN_DECLS
+
+/* GstBatchFrame - one source frame of a batched buffer
+ * source_id: id of the sink pad (sink_%u) the frame came from
+ * pts: original PTS of the frame
+ * width: original width of the frame
+ * height: original height of the frame
+ * buffer: the frame itself, referenced by the batch
+ */
+typedef struct _GstBatchFrame {
+    guint               source_id;
+    GstClockTime        pts;
+    gint                width;
+    gint                height;
+    GstBuffer           *buffer;
+} GstBatchFrame;
+
+/* GstBatchMeta - frames batched by cpubatchmux, the batched buffer itself
+ * carries no memory.
+ * frames: GArray of GstBatchFrame
+ */
+typedef struct _GstBatchMeta {
+    GstMeta             meta;
+    GArray              *frames;
+} GstBatchMeta;
+
+GType gst_batch_meta_api_get_type(void);
+const GstMetaInfo* gst_batch_meta_get_info(void);
+
+#define GST_BATCH_META_API_TYPE       (gst_batch_meta_api_get_type())
+#define GST_BATCH_META_INFO           (gst_batch_meta_get_info())
+
+#define gst_buffer_get_batch_meta(b)  \
+    ((GstBatchMeta*)gst_buffer_get_meta((b), GST_BATCH_META_API_TYPE))
+
+GstBatchMeta* gst_buffer_add_batch_meta(GstBuffer* buffer);
+
+#define GST_TYPE_CPU_BATCH_MUX              (gst_cpu_batch_mux_get_type())
+#define GST_CPU_BATCH_MUX(obj)              (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_CPU_BATCH_MUX, GstCpuBatchMux))
+#define GST_CPU_BATCH_MUX_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_CPU_BATCH_MUX, GstCpuBatchMuxClass))
+#define GST_IS_CPU_BATCH_MUX(obj)           (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_CPU_BATCH_MUX))
+#define GST_IS_CPU_BATCH_MUX_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_CPU_BATCH_MUX))
+#define GST_CPU_BATCH_MUX_CAST(obj)         ((GstCpuBatchMux *)(obj))
+
+typedef struct _GstCpuBatchMux      GstCpuBatchMux;
+typedef struct _GstCpuBatchMuxClass GstCpuBatchMuxClass;
+
+/* GstCpuBatchMux - batch one frame of each sink pad into one buffer with
+ * a GstBatchMeta, frames are neither copied nor scaled.
+ * batch_size: max frames per batch, 0 means the number of sink pads
+ * next_pad: sink pad to start the next batch with, so no source starves
+ */
+struct _GstCpuBatchMux
+{
+    GstAggregator       parent;
+    guint               batch_size;
+    guint               next_pad;
+};
+
+struct _GstCpuBatchMuxClass {
+    GstAggregatorClass  parent;
+};
+
+GType gst_cpu_batch_mux_get_type(void);
+
+/* register "cpubatchmux" to the running process, no plugin needed */
+gboolean gst_cpu_batch_mux_register(void);
+
+G_END_DECLS
+
+#endif /* __GST_CPU_BATCH_MUX_H__ */
@@ -0,0 +1,384 @@
+/*
+ * @Description: Pre-event recording of the encoded stream into MP4 clips.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 20:58:36
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 20:58:36
+ */
+
+#include "EventRecorder.h"
+#include "Logger.h"
+
+static gboolean cb_record_bus_message(GstBus* bus, GstMessage* msg, gpointer user_data)
+{
+    EventRecorder::Recording* recording = static_cast<EventRecorder::Recording*>(user_data);
+    GError* error = nullptr;
+    gchar* debug = nullptr;
+
+    switch (GST_MESSAGE_TYPE(msg)) {
+        case GST_MESSAGE_ERROR:
+            gst_message_parse_error(msg, &error, &debug);
+            LOG_ERROR("Failed to record {}: {}", recording->path, error->message);
+            g_clear_error(&error);
+            g_free(debug);
+            break;
+        case GST_MESSAGE_EOS:
+            LOG_INFO("Record {} finished", recording->path);
+            break;
+        default:
+            return G_SOURCE_CONTINUE;
+    }
+
+    // the watch is removed by returning, recording is gone after this
+    recording->recorder->Release(recording);
+    return G_SOURCE_REMOVE;
+}
+
+EventRecorder::EventRecorder(GstClockTime pre_event, GstClockTime post_event,
+    size_t max_bytes, GMainContext* context) :
+    m_preEvent  (pre_event),
+    m_postEvent (post_event),
+    m_maxBytes  (max_bytes),
+    m_context   (context),
+    m_caps      (nullptr),
+    m_bytes     (0),
+    m_lastTs    (GST_CLOCK_TIME_NONE),
+    m_overBudget(false),
+    m_active    (nullptr),
+    m_stopTs    (GST_CLOCK_TIME_NONE),
+    m_base      (GST_CLOCK_TIME_NONE),
+    m_waitKey   (true)
+{
+
+}
+
+EventRecorder::~EventRecorder()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_active) {
+        FinishLocked();
+    }
+
+    // clips are finalized here, nobody runs the bus watches anymore
+    for (Recording* recording : m_finishing) {
+        CloseLocked(recording);
+    }
+    m_finishing.clear();
+
+    while (!m_gops.empty()) {
+        PopGopLocked();
+    }
+
+    if (m_caps) {
+        gst_caps_unref(m_caps);
+        m_caps = nullptr;
+    }
+}
+
+void EventRecorder::SetCaps(GstCaps* caps)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    gst_caps_replace(&m_caps, caps);
+    if (m_active) {
+        gst_app_src_set_caps(GST_APP_SRC(m_active->appsrc), caps);
+    }
+}
+
+/**
+ * @brief Called in the streaming thread for every encoded buffer.
+ * @Author: Ricardo Lu
+ * @param[in] buffer - H.264 access unit, still owned by the caller.
+ */
+void EventRecorder::Push(GstBuffer* buffer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool key = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    GstBuffer* copy;
+    size_t size;
+
+    if (!GST_CLOCK_TIME_IS_VALID(GST_BUFFER_DTS_OR_PTS(buffer))) {
+        return;
+    }
+    m_lastTs = GST_BUFFER_DTS_OR_PTS(buffer);
+
+    if (m_active) {
+        PushLocked(buffer);
+        if (GST_CLOCK_TIME_IS_VALID(m_stopTs) && m_lastTs >= m_stopTs) {
+            FinishLocked();
+        }
+    }
+
+    // the ring keeps going while recording, a next event gets its pre-event too
+    if (key) {
+        m_gops.push_back({ m_lastTs, 0, { } });
+    } else if (m_gops.empty()) {
+        return;
+    }
+
+    // encoders hand out buffers of their own pool, never hold them
+    copy = gst_buffer_copy_deep(buffer);
+    size = gst_buffer_get_size(copy);
+    m_gops.back().buffers.push_back(copy);
+    m_gops.back().bytes += size;
+    m_bytes += size;
+
+    // the oldest GOP goes once the others still cover the pre-event time
+    while (m_gops.size() > 1 && m_lastTs - m_gops[1].start >= m_preEvent) {
+        PopGopLocked();
+    }
+
+    while (m_bytes > m_maxBytes && !m_gops.empty()) {
+        if (!m_overBudget) {
+            LOG_WARN("Pre-event ring is over {} bytes, holds less than {}s",
+                m_maxBytes, m_preEvent / GST_SECOND);
+            m_overBudget = true;
+        }
+        PopGopLocked();
+    }
+}
+
+/**
+ * @brief Start a clip with the buffered pre-event, or extend the current one.
+ * @Author: Ricardo Lu
+ * @param[in] path - of the MP4 file, ignored when extending.
+ */
+bool EventRecorder::Trigger(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    GstElement *parse, *mux, *sink;
+    Recording* recording;
+    bool added = false;
+    GstBus* bus;
+
+    if (m_active) {
+        if (m_postEvent && GST_CLOCK_TIME_IS_VALID(m_lastTs)) {
+            m_stopTs = m_lastTs + m_postEvent;
+        }
+        LOG_INFO("Record {} extended", m_active->path);
+        return true;
+    }
+
+    if (!m_caps) {
+        LOG_WARN("No encoded stream yet, can't record {}", path);
+        return false;
+    }
+
+    recording = new Recording { this, nullptr, nullptr, nullptr, path };
+    recording->pipeline = gst_pipeline_new("recorder");
+    recording->appsrc = gst_element_factory_make("appsrc", "recsrc0");
+    parse = gst_element_factory_make("h264parse", "h264parse1");
+    mux = gst_element_factory_make("mp4mux", "mp4mux0");
+    sink = gst_element_factory_make("filesink", "filesink0");
+
+    if (!recording->pipeline || !recording->appsrc || !parse || !mux || !sink) {
+        LOG_ERROR("Failed to create elements of recorder for {}", path);
+        goto exit;
+    }
+
+    // the whole pre-event is pushed at once, appsrc must take it
+    g_object_set(G_OBJECT(recording->appsrc), "format", GST_FORMAT_TIME,
+        "caps", m_caps, "max-bytes", (guint64)0, "block", false, nullptr);
+    g_object_set(G_OBJECT(sink), "location", path.c_str(), nullptr);
+
+    gst_bin_add_many(GST_BIN(recording->pipeline), recording->appsrc, parse, mux, sink, nullptr);
+    // owned by the pipeline from now on
+    added = true;
+
+    // byte-stream from a decoder passthrough is converted to avc for mp4mux
+    if (!gst_element_link_many(recording->appsrc, parse, mux, sink, nullptr)) {
+        LOG_ERROR("Failed to link recsrc0->h264parse1->mp4mux0->filesink0");
+        goto exit;
+    }
+
+    bus = gst_pipeline_get_bus(GST_PIPELINE(recording->pipeline));
+    recording->bus_watch = gst_bus_create_watch(bus);
+    g_source_set_callback(recording->bus_watch, (GSourceFunc)cb_record_bus_message, recording, nullptr);
+    g_source_attach(recording->bus_watch, m_context);
+    gst_object_unref(bus);
+
+    if (GST_STATE_CHANGE_FAILURE == gst_element_set_state(recording->pipeline, GST_STATE_PLAYING)) {
+        LOG_ERROR("Failed to start recorder for {}", path);
+        goto exit;
+    }
+
+    m_active = recording;
+    m_base = GST_CLOCK_TIME_NONE;
+    m_waitKey = true;
+    m_stopTs = m_postEvent && GST_CLOCK_TIME_IS_VALID(m_lastTs) ?
+        m_lastTs + m_postEvent : GST_CLOCK_TIME_NONE;
+
+    LOG_INFO("Record {} with {}ms before the event", path, BufferedLocked() / GST_MSECOND);
+    for (const Gop& gop : m_gops) {
+        for (GstBuffer* buffer : gop.buffers) {
+            PushLocked(buffer);
+        }
+    }
+
+    return true;
+
+exit:
+    if (recording->bus_watch) {
+        g_source_destroy(recording->bus_watch);
+        g_source_unref(recording->bus_watch);
+    }
+    if (!added) {
+        for (GstElement* element : { recording->appsrc, parse, mux, sink }) {
+            if (element) {
+                gst_object_unref(element);
+            }
+        }
+    }
+    if (recording->pipeline) {
+        gst_element_set_state(recording->pipeline, GST_STATE_NULL);
+        gst_object_unref(recording->pipeline);
+    }
+    delete recording;
+    return false;
+}
+
+/**
+ * @brief End of the event, the clip is finalized in the background.
+ * @Author: Ricardo Lu
+ */
+void EventRecorder::Stop()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_active) {
+        FinishLocked();
+    }
+}
+
+/**
+ * @brief Drop the ring and end the clip, e.g. when the stream goes away.
+ * @Author: Ricardo Lu
+ */
+void EventRecorder::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_active) {
+        FinishLocked();
+    }
+
+    while (!m_gops.empty()) {
+        PopGopLocked();
+    }
+    m_lastTs = GST_CLOCK_TIME_NONE;
+}
+
+// bus watch of the recording, EOS or error
+void EventRecorder::Release(Recording* recording)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (recording == m_active) {
+        m_active = nullptr;
+    }
+    for (auto it = m_finishing.begin(); it != m_finishing.end(); ++it) {
+        if (*it == recording) {
+            m_finishing.erase(it);
+            break;
+        }
+    }
+
+    gst_element_set_state(recording->pipeline, GST_STATE_NULL);
+    gst_object_unref(recording->pipeline);
+    // removed by the watch returning G_SOURCE_REMOVE
+    g_source_unref(recording->bus_watch);
+    delete recording;
+}
+
+GstClockTime EventRecorder::Buffered()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return BufferedLocked();
+}
+
+GstClockTime EventRecorder::BufferedLocked()
+{
+    if (m_gops.empty() || !GST_CLOCK_TIME_IS_VALID(m_lastTs)) {
+        return 0;
+    }
+
+    return m_lastTs - m_gops.front().start;
+}
+
+void EventRecorder::PopGopLocked()
+{
+    Gop& gop = m_gops.front();
+
+    for (GstBuffer* buffer : gop.buffers) {
+        gst_buffer_unref(buffer);
+    }
+    m_bytes -= gop.bytes;
+    m_gops.pop_front();
+}
+
+// timestamps of the clip start at 0
+void EventRecorder::PushLocked(GstBuffer* buffer)
+{
+    GstBuffer* copy;
+
+    if (m_waitKey) {
+        if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+            return;
+        }
+        m_waitKey = false;
+        m_base = GST_BUFFER_DTS_OR_PTS(buffer);
+    }
+
+    copy = gst_buffer_copy(buffer);
+    if (GST_BUFFER_PTS_IS_VALID(copy)) {
+        GST_BUFFER_PTS(copy) = GST_BUFFER_PTS(copy) > m_base ? GST_BUFFER_PTS(copy) - m_base : 0;
+    }
+    if (GST_BUFFER_DTS_IS_VALID(copy)) {
+        GST_BUFFER_DTS(copy) = GST_BUFFER_DTS(copy) > m_base ? GST_BUFFER_DTS(copy) - m_base : 0;
+    }
+
+    if (gst_app_src_push_buffer(GST_APP_SRC(m_active->appsrc), copy) != GST_FLOW_OK) {
+        LOG_WARN("Failed to push into recorder of {}", m_active->path);
+    }
+}
+
+void EventRecorder::FinishLocked()
+{
+    LOG_INFO("Record {} stopping", m_active->path);
+
+    gst_app_src_end_of_stream(GST_APP_SRC(m_active->appsrc));
+    m_finishing.push_back(m_active);
+    m_active = nullptr;
+    m_stopTs = GST_CLOCK_TIME_NONE;
+}
+
+// without the bus watch, waits for mp4mux to write the index
+void EventRecorder::CloseLocked(Recording* recording)
+{
+    GstBus* bus;
+    GstMessage* msg;
+
+    if (recording->bus_watch) {
+        g_source_destroy(recording->bus_watch);
+        g_source_unref(recording->bus_watch);
+        recording->bus_watch = nullptr;
+    }
+
+    bus = gst_pipeline_get_bus(GST_PIPELINE(recording->pipeline));
+    msg = gst_bus_timed_pop_filtered(bus, 3 * GST_SECOND,
+        (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    if (!msg || GST_MESSAGE_TYPE(msg) != GST_MESSAGE_EOS) {
+        LOG_WARN("Record {} isn't finalized", recording->path);
+    }
+    if (msg) {
+        gst_message_unref(msg);
+    }
+    gst_object_unref(bus);
+
+    gst_element_set_state(recording->pipeline, GST_STATE_NULL);
+    gst_object_unref(recording->pipeline);
+    delete recording;
+}
@@ -0,0 +1,76 @@
+/*
+ * @Description: Per-frame latency from decoder output to the branch sinks.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 18:31:02
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 18:31:02
+ */
+
+#include "LatencyTracer.h"
+
+/*----------------------------GstLatencyMeta----------------------------*/
+
+static gboolean gst_latency_meta_init(GstMeta *meta, gpointer params, GstBuffer *buffer)
+{
+    GstLatencyMeta *latency_meta = (GstLatencyMeta*)meta;
+
+    latency_meta->stamp = 0;
+
+    return TRUE;
+}
+
+// converted and copied buffers keep the stamp of the frame they came from
+static gboolean gst_latency_meta_transform(GstBuffer *transbuf, GstMeta *meta,
+    GstBuffer *buffer, GQuark type, gpointer data)
+{
+    GstLatencyMeta *src = (GstLatencyMeta*)meta;
+
+    if (gst_buffer_get_latency_meta(transbuf)) {
+        return TRUE;
+    }
+
+    return gst_buffer_add_latency_meta(transbuf, src->stamp) != NULL;
+}
+
+GType gst_latency_meta_api_get_type(void)
+{
+    static gsize type = 0;
+    // no tags, so elements transforming the frame are free to copy it
+    static const gchar *tags[] = { NULL };
+
+    if (g_once_init_enter(&type)) {
+        GType _type = gst_meta_api_type_register("GstLatencyMetaAPI", tags);
+        g_once_init_leave(&type, _type);
+    }
+
+    return (GType)type;
+}
+
+const GstMetaInfo* gst_latency_meta_get_info(void)
+{
+    static const GstMetaInfo *meta_info = NULL;
+
+    if (g_once_init_enter((GstMetaInfo**)&meta_info)) {
+        const GstMetaInfo *mi = gst_meta_register(GST_LATENCY_META_API_TYPE,
+            "GstLatencyMeta", sizeof(GstLatencyMeta), gst_latency_meta_init,
+            (GstMetaFreeFunction)NULL, gst_latency_meta_transform);
+        g_once_init_leave((GstMetaInfo**)&meta_info, (GstMetaInfo*)mi);
+    }
+
+    return meta_info;
+}
+
+GstLatencyMeta* gst_buffer_add_latency_meta(GstBuffer* buffer, int64_t stamp)
+{
+    GstLatencyMeta *meta;
+
+    g_return_val_if_fail(GST_IS_BUFFER(buffer), NULL);
+
+    meta = (GstLatencyMeta*)gst_buffer_add_meta(buffer, GST_LATENCY_META_INFO, NULL);
+    if (meta) {
+        meta->stamp = stamp;
+    }
+
+    return meta;
+}
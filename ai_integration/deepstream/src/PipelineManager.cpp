@@ -0,0 +1,627 @@
+/*
+ * @Description: Run many VideoPipeline instances in one process.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 17:20:45
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 04:44:19
+ */
+
+#include "PipelineManager.h"
+
+struct RestartRequest {
+    PipelineManager*    manager;
+    std::string         id;
+};
+
+static gboolean cb_restart_pipeline(gpointer user_data)
+{
+    RestartRequest* request = static_cast<RestartRequest*>(user_data);
+
+    if (!request->manager->Restart(request->id)) {
+        LOG_ERROR("Pipeline[{}]: failed to restart", request->id);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean cb_stop_pipeline(gpointer user_data)
+{
+    RestartRequest* request = static_cast<RestartRequest*>(user_data);
+
+    request->manager->Stop(request->id);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean cb_refill_standby(gpointer user_data)
+{
+    static_cast<PipelineManager*>(user_data)->RefillStandby();
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean cb_bus_message(GstBus* bus, GstMessage* msg, gpointer user_data)
+{
+    PipelineManager::PipelineEntry* entry =
+        static_cast<PipelineManager::PipelineEntry*>(user_data);
+    GError* error = nullptr;
+    gchar* debug = nullptr;
+
+    switch (GST_MESSAGE_TYPE(msg)) {
+        case GST_MESSAGE_ERROR: {
+            gst_message_parse_error(msg, &error, &debug);
+            LOG_ERROR("Pipeline[{}]: error from {}: {}", entry->config.pipeline_id,
+                GST_OBJECT_NAME(msg->src), error->message);
+            LOG_ERROR("Pipeline[{}]: debug info: {}", entry->config.pipeline_id,
+                debug ? debug : "none");
+            g_clear_error(&error);
+            g_free(debug);
+
+            // can't tear down the pipeline from its own bus watch
+            entry->manager->ScheduleRestart(entry->config.pipeline_id);
+            return G_SOURCE_REMOVE;
+        }
+        case GST_MESSAGE_WARNING:
+            gst_message_parse_warning(msg, &error, &debug);
+            LOG_WARN("Pipeline[{}]: warning from {}: {}", entry->config.pipeline_id,
+                GST_OBJECT_NAME(msg->src), error->message);
+            g_clear_error(&error);
+            g_free(debug);
+            break;
+        case GST_MESSAGE_EOS:
+            LOG_INFO("Pipeline[{}]: end of stream", entry->config.pipeline_id);
+            break;
+        default:
+            break;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+PipelineManager::PipelineManager()
+{
+    m_context = g_main_context_new();
+    m_loop = g_main_loop_new(m_context, FALSE);
+    m_setupFunc = nullptr;
+    m_nextId = 0;
+    m_nextStandby = 0;
+    m_standbySize = 0;
+    m_refillPending = false;
+    m_restartInterval = 500;
+    m_restartMaxInterval = 30000;
+    m_restartMaxAttempts = 10;
+    m_restartToken = 0;
+}
+
+PipelineManager::~PipelineManager()
+{
+    StopAll();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pipelines.clear();
+        m_standbySize = 0;
+        for (auto& entry : m_standby) {
+            StopLocked(entry.get());
+        }
+        m_standby.clear();
+    }
+
+    if (m_loop) {
+        g_main_loop_unref(m_loop);
+        m_loop = nullptr;
+    }
+
+    if (m_context) {
+        g_main_context_unref(m_context);
+        m_context = nullptr;
+    }
+}
+
+std::string PipelineManager::UniqueIdLocked(const std::string& id)
+{
+    std::string unique = id;
+
+    // ids name the pipelines, their logs and dot files, so they must be unique
+    if (unique.empty() || m_pipelines.count(unique)) {
+        do {
+            unique = "pipeline" + std::to_string(m_nextId++);
+        } while (m_pipelines.count(unique));
+
+        LOG_WARN("Pipeline name '{}' is empty or in use, rename to {}", id, unique);
+    }
+
+    return unique;
+}
+
+bool PipelineManager::Add(VideoPipelineConfig config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    config.pipeline_id = UniqueIdLocked(config.pipeline_id);
+
+    std::unique_ptr<PipelineEntry> entry(new PipelineEntry());
+    entry->manager = this;
+    entry->config = config;
+    entry->pipeline = nullptr;
+    entry->bus_watch = nullptr;
+    entry->restart_count = 0;
+    entry->restart_source = nullptr;
+    entry->restart_token = 0;
+
+    LOG_INFO("Add pipeline {}, {} pipelines in total", config.pipeline_id,
+        m_pipelines.size() + 1);
+    m_pipelines[config.pipeline_id] = std::move(entry);
+
+    return true;
+}
+
+bool PipelineManager::Remove(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_pipelines.find(id);
+    if (it == m_pipelines.end()) {
+        LOG_WARN("Pipeline[{}]: not found", id);
+        return false;
+    }
+
+    StopLocked(it->second.get());
+    m_pipelines.erase(it);
+
+    return true;
+}
+
+/**
+ * @brief Start a stream on a warm standby pipeline, or from scratch when
+ * none is left. A bound pipeline keeps every setting of the warm pool
+ * config except the id and the uri, and is rebuilt with them on restart.
+ * @Author: Ricardo Lu
+ */
+bool PipelineManager::Bind(VideoPipelineConfig config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_ptr<PipelineEntry> entry;
+    PipelineEntry* bound;
+    GSource* source;
+
+    config.pipeline_id = UniqueIdLocked(config.pipeline_id);
+
+    if (m_standby.empty()) {
+        LOG_WARN("Pipeline[{}]: no standby pipeline, start from scratch", config.pipeline_id);
+        entry.reset(new PipelineEntry());
+        entry->manager = this;
+        entry->config = config;
+        entry->pipeline = nullptr;
+        entry->bus_watch = nullptr;
+        entry->restart_count = 0;
+        entry->restart_source = nullptr;
+        entry->restart_token = 0;
+        bound = entry.get();
+        m_pipelines[config.pipeline_id] = std::move(entry);
+        return StartLocked(bound);
+    }
+
+    entry = std::move(m_standby.back());
+    m_standby.pop_back();
+    bound = entry.get();
+    bound->config.pipeline_id = config.pipeline_id;
+    bound->config.src_uri = config.src_uri;
+    m_pipelines[config.pipeline_id] = std::move(entry);
+
+    // the pool is refilled off the bind path
+    if (!m_refillPending) {
+        m_refillPending = true;
+        source = g_idle_source_new();
+        g_source_set_callback(source, cb_refill_standby, this, nullptr);
+        g_source_attach(source, m_context);
+        g_source_unref(source);
+    }
+
+    WatchLocked(bound);
+    if (!bound->pipeline->BindSource(config.pipeline_id, config.src_uri)) {
+        LOG_ERROR("Pipeline[{}]: bind failed", config.pipeline_id);
+        StopLocked(bound);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Keep size pipelines created and READY for Bind().
+ * @Author: Ricardo Lu
+ * @param[in] config - template of the standby pipelines, a single uri source.
+ * @param[in] size - 0 to release the pool.
+ */
+bool PipelineManager::SetWarmPool(const VideoPipelineConfig& config, size_t size)
+{
+    std::vector<std::unique_ptr<PipelineEntry> > released;
+
+    if (!config.batch_sources.empty() || config.input_type == VideoType::USB_CAMERE) {
+        LOG_ERROR("Warm pool only supports pipelines of a single uri source");
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_standbyConfig = config;
+        m_standbyConfig.src_uri.clear();
+        m_standbySize = size;
+
+        while (m_standby.size() > size) {
+            released.push_back(std::move(m_standby.back()));
+            m_standby.pop_back();
+        }
+    }
+
+    // never bound, nothing else refers to them
+    for (auto& entry : released) {
+        StopLocked(entry.get());
+    }
+
+    LOG_INFO("Warm pool of {} pipelines", size);
+    RefillStandby();
+
+    return true;
+}
+
+// pipelines are built without m_mutex, the loop keeps running meanwhile
+void PipelineManager::RefillStandby()
+{
+    std::unique_ptr<PipelineEntry> entry;
+    int64_t start;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_refillPending = false;
+    }
+
+    while (true) {
+        entry.reset(new PipelineEntry());
+        entry->manager = this;
+        entry->bus_watch = nullptr;
+        entry->restart_count = 0;
+        entry->restart_source = nullptr;
+        entry->restart_token = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_standby.size() >= m_standbySize) {
+                break;
+            }
+            entry->config = m_standbyConfig;
+            entry->config.pipeline_id = "standby" + std::to_string(m_nextStandby++);
+        }
+
+        entry->pipeline = new VideoPipeline(entry->config, m_context);
+        if (m_setupFunc) {
+            m_setupFunc(entry->pipeline);
+        }
+
+        start = g_get_monotonic_time();
+        if (!entry->pipeline->Create() || !entry->pipeline->Warm()) {
+            LOG_ERROR("Pipeline[{}]: failed to create standby", entry->config.pipeline_id);
+            StopLocked(entry.get());
+            break;
+        }
+
+        LOG_INFO("Pipeline[{}]: standby ready in {}ms", entry->config.pipeline_id,
+            (g_get_monotonic_time() - start) / 1000.0);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // the pool may have shrunk, or been filled by another refill
+            if (m_standby.size() < m_standbySize) {
+                m_standby.push_back(std::move(entry));
+                continue;
+            }
+        }
+
+        StopLocked(entry.get());
+        break;
+    }
+}
+
+void PipelineManager::WatchLocked(PipelineEntry* entry)
+{
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(entry->pipeline->m_pipeline));
+
+    entry->bus_watch = gst_bus_create_watch(bus);
+    g_source_set_callback(entry->bus_watch, (GSourceFunc)cb_bus_message, entry, nullptr);
+    g_source_attach(entry->bus_watch, m_context);
+    gst_object_unref(bus);
+}
+
+bool PipelineManager::StartLocked(PipelineEntry* entry)
+{
+    if (entry->pipeline) {
+        return entry->pipeline->Resume();
+    }
+
+    // a restart building meanwhile is dropped, this one runs
+    CancelRestartLocked(entry);
+    entry->pipeline = new VideoPipeline(entry->config, m_context);
+
+    if (m_setupFunc) {
+        m_setupFunc(entry->pipeline);
+    }
+
+    if (!entry->pipeline->Create()) {
+        LOG_ERROR("Pipeline[{}]: create failed", entry->config.pipeline_id);
+        goto exit;
+    }
+
+    WatchLocked(entry);
+
+    if (!entry->pipeline->Start()) {
+        LOG_ERROR("Pipeline[{}]: start failed", entry->config.pipeline_id);
+        goto exit;
+    }
+
+    return true;
+
+exit:
+    StopLocked(entry);
+    return false;
+}
+
+void PipelineManager::StopLocked(PipelineEntry* entry)
+{
+    CancelRestartLocked(entry);
+
+    if (entry->bus_watch) {
+        g_source_destroy(entry->bus_watch);
+        g_source_unref(entry->bus_watch);
+        entry->bus_watch = nullptr;
+    }
+
+    if (entry->pipeline) {
+        delete entry->pipeline;
+        entry->pipeline = nullptr;
+    }
+}
+
+bool PipelineManager::Start(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_pipelines.find(id);
+    if (it == m_pipelines.end()) {
+        LOG_WARN("Pipeline[{}]: not found", id);
+        return false;
+    }
+
+    LOG_INFO("Pipeline[{}]: start", id);
+    return StartLocked(it->second.get());
+}
+
+void PipelineManager::Stop(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_pipelines.find(id);
+    if (it == m_pipelines.end()) {
+        LOG_WARN("Pipeline[{}]: not found", id);
+        return;
+    }
+
+    LOG_INFO("Pipeline[{}]: stop", id);
+    StopLocked(it->second.get());
+}
+
+void PipelineManager::CancelRestartLocked(PipelineEntry* entry)
+{
+    if (entry->restart_source) {
+        g_source_destroy(entry->restart_source);
+        g_source_unref(entry->restart_source);
+        entry->restart_source = nullptr;
+    }
+
+    entry->restart_token = 0;
+}
+
+/**
+ * @brief Restart a failed pipeline after a backoff, doubled on every attempt
+ * until a run gets a frame. The pipeline is stopped after m_restartMaxAttempts.
+ * @Author: Ricardo Lu
+ * @param[in] id - of the failed pipeline.
+ */
+void PipelineManager::ScheduleRestart(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_pipelines.find(id);
+    if (it == m_pipelines.end()) {
+        LOG_WARN("Pipeline[{}]: not found", id);
+        return;
+    }
+
+    ScheduleRestartLocked(it->second.get());
+}
+
+void PipelineManager::ScheduleRestartLocked(PipelineEntry* entry)
+{
+    RestartRequest* request;
+    guint delay;
+
+    if (entry->restart_source) {
+        return;
+    }
+
+    // the last run got a frame, so the previous restart worked
+    if (entry->pipeline && entry->pipeline->GetTimeToFirstFrame() >= 0) {
+        entry->restart_count = 0;
+    }
+
+    request = new RestartRequest { this, entry->config.pipeline_id };
+
+    if (m_restartMaxAttempts > 0 && entry->restart_count >= m_restartMaxAttempts) {
+        LOG_ERROR("Pipeline[{}]: failed {} restarts in a row, stop it",
+            entry->config.pipeline_id, entry->restart_count);
+        entry->restart_source = g_idle_source_new();
+        g_source_set_callback(entry->restart_source, cb_stop_pipeline, request,
+            [](gpointer data) { delete static_cast<RestartRequest*>(data); });
+    } else {
+        delay = MIN((guint64)m_restartInterval << MIN(entry->restart_count, 16),
+            (guint64)m_restartMaxInterval);
+        LOG_WARN("Pipeline[{}]: restart in {}ms (attempt {})",
+            entry->config.pipeline_id, delay, entry->restart_count + 1);
+        entry->restart_source = g_timeout_source_new(delay);
+        g_source_set_callback(entry->restart_source, cb_restart_pipeline, request,
+            [](gpointer data) { delete static_cast<RestartRequest*>(data); });
+    }
+
+    g_source_attach(entry->restart_source, m_context);
+}
+
+// torn down and rebuilt without m_mutex, the loop keeps running meanwhile
+bool PipelineManager::Restart(const std::string& id)
+{
+    PipelineEntry* entry;
+    VideoPipeline* stopped;
+    VideoPipeline* pipeline;
+    VideoPipelineConfig config;
+    uint64_t token;
+    bool ret;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_pipelines.find(id);
+        if (it == m_pipelines.end()) {
+            LOG_WARN("Pipeline[{}]: not found", id);
+            return false;
+        }
+
+        entry = it->second.get();
+        CancelRestartLocked(entry);
+        if (entry->bus_watch) {
+            g_source_destroy(entry->bus_watch);
+            g_source_unref(entry->bus_watch);
+            entry->bus_watch = nullptr;
+        }
+        stopped = entry->pipeline;
+        entry->pipeline = nullptr;
+
+        // Start(), Stop() or Remove() meanwhile drop this restart
+        token = entry->restart_token = ++m_restartToken;
+        config = entry->config;
+        LOG_INFO("Pipeline[{}]: restart({})", id, ++entry->restart_count);
+    }
+
+    if (stopped) {
+        delete stopped;
+    }
+
+    // rebuilt from scratch, the other pipelines keep running
+    pipeline = new VideoPipeline(config, m_context);
+    if (m_setupFunc) {
+        m_setupFunc(pipeline);
+    }
+    ret = pipeline->Create() && pipeline->Start();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_pipelines.find(id);
+        if (it == m_pipelines.end() || it->second->restart_token != token) {
+            LOG_WARN("Pipeline[{}]: stopped while restarting", id);
+            ret = false;
+        } else if (!ret) {
+            LOG_ERROR("Pipeline[{}]: restart failed", id);
+            ScheduleRestartLocked(it->second.get());
+        } else {
+            entry = it->second.get();
+            entry->restart_token = 0;
+            entry->pipeline = pipeline;
+            // messages of the start wait in the bus until watched
+            WatchLocked(entry);
+            return true;
+        }
+    }
+
+    delete pipeline;
+    return false;
+}
+
+/**
+ * @brief Backoff of the restarts on error.
+ * @Author: Ricardo Lu
+ * @param[in] interval - ms before the first restart, doubled on every attempt.
+ * @param[in] max_interval - ms, cap of the backoff.
+ * @param[in] max_attempts - restarts in a row without a frame before the
+ * pipeline is stopped, 0 for no limit.
+ */
+void PipelineManager::SetRestartPolicy(int interval, int max_interval, int max_attempts)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_restartInterval = MAX(interval, 0);
+    m_restartMaxInterval = MAX(max_interval, m_restartInterval);
+    m_restartMaxAttempts = MAX(max_attempts, 0);
+
+    LOG_INFO("Restart after {}ms, up to {}ms, {} attempts at most", m_restartInterval,
+        m_restartMaxInterval, m_restartMaxAttempts);
+}
+
+bool PipelineManager::StartAll()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool ret = true;
+
+    for (auto& it : m_pipelines) {
+        if (!StartLocked(it.second.get())) {
+            LOG_ERROR("Pipeline[{}]: failed to start", it.first);
+            ret = false;
+        }
+    }
+
+    return ret;
+}
+
+void PipelineManager::StopAll()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& it : m_pipelines) {
+        StopLocked(it.second.get());
+    }
+}
+
+void PipelineManager::Run()
+{
+    LOG_INFO("PipelineManager run with {} pipelines", Size());
+
+    g_main_context_push_thread_default(m_context);
+    g_main_loop_run(m_loop);
+    g_main_context_pop_thread_default(m_context);
+}
+
+void PipelineManager::Quit()
+{
+    g_main_loop_quit(m_loop);
+}
+
+void PipelineManager::SetCallbacks(PipelineSetupFunc func)
+{
+    LOG_INFO("set PipelineSetupFunc callback called");
+
+    m_setupFunc = func;
+}
+
+VideoPipeline* PipelineManager::Get(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_pipelines.find(id);
+    return it == m_pipelines.end() ? nullptr : it->second->pipeline;
+}
+
+size_t PipelineManager::Size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_pipelines.size();
+}
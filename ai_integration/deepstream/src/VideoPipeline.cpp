@@ -4,10 +4,199 @@
  * @Author: Ricardo Lu<shenglu1202@163.com>
  * @Date: 2022-07-15 22:07:19
  * @LastEditors: Ricardo Lu
- * @LastEditTime: 2023-02-06 21:04:48
+ * @LastEditTime: 2026-10-18 04:45:22
  */
 
+#include <cmath>
+#include <cstdio>
+
+#ifdef ENABLE_DEEPSTREAM
+#include <gstnvdsmeta.h>
+#include <nvbufsurface.h>
+#endif
+
 #include "VideoPipeline.h"
+#include "gstcpubatchmux.h"
+
+static void release_request_pads(GstElement* element)
+{
+    GList* pads;
+
+    if (!element) {
+        return;
+    }
+
+    GST_OBJECT_LOCK(element);
+    pads = g_list_copy_deep(element->srcpads, (GCopyFunc)gst_object_ref, nullptr);
+    GST_OBJECT_UNLOCK(element);
+
+    for (GList* l = pads; l; l = l->next) {
+        gst_element_release_request_pad(element, GST_PAD(l->data));
+    }
+
+    g_list_free_full(pads, gst_object_unref);
+}
+
+static void cb_queue_overrun(GstElement* queue, gpointer user_data)
+{
+    std::atomic<uint64_t>* dropped = static_cast<std::atomic<uint64_t>*>(user_data);
+
+    // a leaky queue drops one buffer per overrun, only the first one is logged
+    if (dropped->fetch_add(1) == 0) {
+        LOG_WARN("Pipeline[{}]: {} is full, start dropping buffers",
+            GST_OBJECT_NAME(GST_OBJECT_PARENT(queue)), GST_ELEMENT_NAME(queue));
+    }
+}
+
+static void configure_queue(
+    GstElement* queue,
+    const QueueConfig& config,
+    std::atomic<uint64_t>* dropped)
+{
+    g_object_set(G_OBJECT(queue), "max-size-buffers", config.max_buffers,
+        "max-size-bytes", config.max_bytes, "max-size-time", config.max_time,
+        "leaky", config.leaky, nullptr);
+
+    // overrun is only emitted by a non-silent queue
+    if (config.leaky) {
+        g_object_set(G_OBJECT(queue), "silent", FALSE, nullptr);
+        g_signal_connect(queue, "overrun", G_CALLBACK(cb_queue_overrun), dropped);
+    }
+}
+
+// units and names of the rate control differ from encoder to encoder
+static void configure_encoder(
+    GstElement* encoder,
+    const BackendProfile* backend,
+    int bitrate,
+    int iframe_interval)
+{
+    switch (backend->type) {
+        case BACKEND_QTI:
+            g_object_set(G_OBJECT(encoder), "target-bitrate", bitrate,
+                "interval-intraframes", iframe_interval, nullptr);
+            break;
+        case BACKEND_SOFTWARE:
+            // kbit/s, and no lookahead to keep up with a live stream
+            g_object_set(G_OBJECT(encoder), "bitrate", MAX(bitrate / 1000, 1),
+                "key-int-max", iframe_interval, nullptr);
+            gst_util_set_object_arg(G_OBJECT(encoder), "tune", "zerolatency");
+            gst_util_set_object_arg(G_OBJECT(encoder), "speed-preset", "ultrafast");
+            break;
+        default:
+            g_object_set(G_OBJECT(encoder), "bitrate", bitrate,
+                "iframeinterval", iframe_interval, nullptr);
+            break;
+    }
+}
+
+static void configure_display(
+    GstElement* display,
+    const VideoPipelineConfig& config)
+{
+    GObjectClass* klass = G_OBJECT_GET_CLASS(display);
+
+    // autovideosink only proxies sync on newer GStreamer
+    if (g_object_class_find_property(klass, "sync")) {
+        g_object_set(G_OBJECT(display), "sync", config.hdmi_sync, nullptr);
+    }
+
+    if (g_object_class_find_property(klass, "window-x")) {
+        g_object_set(G_OBJECT(display),
+            "window-x", config.window_x,
+            "window-y", config.window_y,
+            "window-width", config.window_width,
+            "window-height", config.window_height, nullptr);
+    } else {
+        LOG_INFO("Window placement isn't supported by {}", GST_ELEMENT_NAME(display));
+    }
+}
+
+// frames held by the delay line are late by its measured delay, 0 without
+static void configure_sink_delay(GstElement* sink, int64_t delay)
+{
+    if (sink && g_object_class_find_property(G_OBJECT_GET_CLASS(sink), "ts-offset")) {
+        g_object_set(G_OBJECT(sink), "ts-offset", (gint64)delay, nullptr);
+    }
+}
+
+static GstPadProbeReturn cb_latency_stamp_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    GST_PAD_PROBE_INFO_DATA(info) = LatencyTracer::Stamp(GST_PAD_PROBE_INFO_BUFFER(info));
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn cb_display_latency_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+
+    vp->m_latencyTracer.Record(LATENCY_DISPLAY, GST_PAD_PROBE_INFO_BUFFER(info));
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn cb_rtmp_latency_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+
+    vp->m_latencyTracer.Record(LATENCY_RTMP, GST_PAD_PROBE_INFO_BUFFER(info));
+
+    return GST_PAD_PROBE_OK;
+}
+
+// the probes live as long as their pads, no need to remove them in Destroy()
+static void add_latency_probe(
+    GstElement* element,
+    const char* pad_name,
+    GstPadProbeCallback callback,
+    VideoPipeline* vp)
+{
+    GstPad* pad = gst_element_get_static_pad(element, pad_name);
+
+    if (!pad) {
+        LOG_ERROR("Could not find '{}' in '{}'", pad_name, GST_ELEMENT_NAME(element));
+        return;
+    }
+
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, callback,
+        static_cast<void*>(vp), nullptr);
+    gst_object_unref(pad);
+}
+
+// removed after the first buffer into tee0
+static GstPadProbeReturn cb_first_frame_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+    int64_t elapsed = g_get_monotonic_time() - vp->m_startTime;
+
+    vp->m_timeToFirstFrame = elapsed;
+    LOG_INFO("Pipeline[{}]: time to first frame: {}ms ({} start)", vp->m_config.pipeline_id,
+        elapsed / 1000.0, vp->m_warmStart ? "warm" : "cold");
+
+    return GST_PAD_PROBE_REMOVE;
+}
+
+static gboolean cb_dump_latency(gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+
+    vp->DumpLatency();
+
+    return G_SOURCE_CONTINUE;
+}
 
 static GstPadProbeReturn cb_sync_before_buffer_probe(
     GstPad* pad,
@@ -60,13 +249,30 @@ static GstPadProbeReturn cb_queue0_probe(
     //         g_cond_wait(&vp->m_syncCondition, &vp->m_syncMuxtex);
     //     if (!g_atomic_int_dec_and_test(&vp->m_syncCount)) {
     //         //LOG_INFO("m_syncCount:{}/{}", vp->m_syncCount,
-    //         //    pipeline_id);
+    //         //    vp->m_config.pipeline_id);
     //     }
     //     g_mutex_unlock(&vp->m_syncMuxtex);
     // }
 
-    // osd the result
-    if (vp->m_getResultFunc) {
+    // bounded wait for the result of this frame, in the thread of queue00 only
+    if (vp->m_delayLine.Enabled()) {
+        vp->m_delayLine.Wait(GST_BUFFER_PTS(buffer));
+    }
+
+    // osd the result, prefer the one inferred on this very frame
+    if (vp->m_getBatchResultFunc) {
+        const std::shared_ptr<OSDResultBatch> results =
+            vp->m_getBatchResultFunc(GST_BUFFER_PTS(buffer), vp->m_getBatchResultArgs);
+        if (results && vp->m_procBatchResultFunc) {
+            vp->m_procBatchResultFunc(buffer, results);
+        }
+    } else if (vp->m_getPtsResultFunc) {
+        const std::shared_ptr<std::vector<OSDObject> > results =
+            vp->m_getPtsResultFunc(GST_BUFFER_PTS(buffer), vp->m_getPtsResultArgs);
+        if (results && vp->m_procResultFunc) {
+            vp->m_procResultFunc(buffer, results);
+        }
+    } else if (vp->m_getResultFunc) {
         const std::shared_ptr<std::vector<OSDObject> > results =
             vp->m_getResultFunc(vp->m_getResultArgs);
         // to-do: construct nvdsosd metadata
@@ -80,8 +286,148 @@ static GstPadProbeReturn cb_queue0_probe(
     return GST_PAD_PROBE_OK;
 }
 
+// frames enter the delay line as queue00 takes them
+static GstPadProbeReturn cb_delay_push_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+
+    vp->m_delayLine.Push(GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info)), LatencyTracer::Now());
+
+    return GST_PAD_PROBE_OK;
+}
+
+// encoded H.264 out of h264parse0 into the pre-event ring
+static GstPadProbeReturn cb_record_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+    GstCaps* caps;
+
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_CAPS) {
+            gst_event_parse_caps(GST_PAD_PROBE_INFO_EVENT(info), &caps);
+            vp->m_recorder->SetCaps(caps);
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    vp->m_recorder->Push(GST_PAD_PROBE_INFO_BUFFER(info));
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn cb_inference_rate_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    // skipped frames never reach color conversion and appsink
+    if (!vp->m_rateController.Admit(GST_BUFFER_PTS(buffer))) {
+        return GST_PAD_PROBE_DROP;
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+/**
+ * @brief Parse a crop in the src-crop format of nvvideoconvert.
+ * @Author: Ricardo Lu
+ * @param[in] crop - left:top:width:height, empty for the whole frame.
+ * @param[out] rect - empty for the whole frame.
+ */
+static bool parse_crop(const std::string& crop, cv::Rect& rect)
+{
+    int left, top, width, height;
+
+    if (crop.empty()) {
+        rect = cv::Rect();
+        return true;
+    }
+
+    if (sscanf(crop.c_str(), "%d:%d:%d:%d", &left, &top, &width, &height) != 4 ||
+        left < 0 || top < 0 || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    rect = cv::Rect(left, top, width, height);
+    return true;
+}
+
+// caps of capfilter2, no size for the size of the frames in
+static GstCaps* make_infer_caps(const std::string& format, const char* memory, int width, int height)
+{
+    GstCaps* caps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, format.c_str(), nullptr);
+
+    if (width > 0 && height > 0) {
+        gst_caps_set_simple(caps, "width", G_TYPE_INT, width, "height", G_TYPE_INT, height, nullptr);
+    }
+    if (memory) {
+        gst_caps_set_features(caps, 0, gst_caps_features_new(memory, nullptr));
+    }
+
+    return caps;
+}
+
+// smallest size of the aspect of ref no output is upscaled from, ref if none is smaller
+static cv::Size infer_prescale_size(const cv::Size& ref, const MultiScaler& scaler)
+{
+    double scale = 0;
+
+    for (size_t i = 0; i < scaler.Size(); i++) {
+        const ScaleOutputConfig& config = scaler.Config(i);
+        double sx = (double)config.width / ref.width;
+        double sy = (double)config.height / ref.height;
+        scale = std::max(scale, config.letterbox ? std::min(sx, sy) : std::max(sx, sy));
+    }
+
+    if (scale <= 0 || scale >= 1) {
+        return ref;
+    }
+
+    // even, for the chroma planes of nvvideoconvert
+    return cv::Size(std::min(ref.width, std::max(2, (int)std::ceil(ref.width * scale / 2) * 2)),
+        std::min(ref.height, std::max(2, (int)std::ceil(ref.height * scale / 2) * 2)));
+}
+
+// size of the frames into the crop, the crop is clamped against it
+static GstPadProbeReturn cb_crop_caps_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+    GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+    GstCaps* caps;
+    GstStructure* structure;
+    int width, height;
+
+    if (GST_EVENT_TYPE(event) != GST_EVENT_CAPS) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    gst_event_parse_caps(event, &caps);
+    structure = gst_caps_get_structure(caps, 0);
+    if (gst_structure_get_int(structure, "width", &width) &&
+        gst_structure_get_int(structure, "height", &height)) {
+        std::lock_guard<std::mutex> lock(vp->m_cropMutex);
+        vp->m_cropFrameWidth = width;
+        vp->m_cropFrameHeight = height;
+        vp->ApplyCrop();
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
 static GstFlowReturn cb_appsink_new_sample(
-    GstElement* appsink,
+    GstAppSink* appsink,
     gpointer user_data)
 {
     // LOG_INFO("cb_appsink_new_sample called");
@@ -90,15 +436,24 @@ static GstFlowReturn cb_appsink_new_sample(
     GstSample* sample = nullptr;
 
     if (!vp->m_dumped) {
-        GST_DEBUG_BIN_TO_DOT_FILE(GST_BIN(vp->m_pipeline), GST_DEBUG_GRAPH_SHOW_ALL, "video-pipeline");
+        GST_DEBUG_BIN_TO_DOT_FILE(GST_BIN(vp->m_pipeline), GST_DEBUG_GRAPH_SHOW_ALL, GST_OBJECT_NAME(vp->m_pipeline));
         vp->m_dumped = true;
     }
 
-    g_signal_emit_by_name(appsink, "pull-sample", &sample);
+    // called directly by appsink, no signal marshalling per frame
+    sample = gst_app_sink_pull_sample(appsink);
     if (!sample) {
         return GST_FLOW_OK;
     }
 
+    if (vp->m_config.enable_latency_trace) {
+        vp->m_latencyTracer.Record(LATENCY_INFERENCE, gst_sample_get_buffer(sample));
+    }
+
+    if (vp->m_multiScaler.Size()) {
+        vp->ScaleOutputs(sample);
+    }
+
     if (vp->m_putFrameFunc) {
         vp->m_putFrameFunc(sample, vp->m_putFrameArgs);
     } else {
@@ -113,7 +468,7 @@ static gboolean cb_seek_decoded_file(gpointer user_data)
     VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
 
     LOG_INFO("============================================");
-    LOG_INFO("cb_seek_decoded_file called({})", pipeline_id);
+    LOG_INFO("cb_seek_decoded_file called({})", vp->m_config.pipeline_id);
     LOG_INFO("============================================");
 
     gst_element_set_state(vp->m_pipeline, GST_STATE_PAUSED);
@@ -149,7 +504,10 @@ static GstPadProbeReturn cb_reset_stream_probe(
             vp->m_prev_accumulated_base = vp->m_accumulated_base;
             vp->m_accumulated_base += segment->stop;
         } else if (GST_EVENT_TYPE(event) == GST_EVENT_EOS) {
-            g_timeout_add(1, cb_seek_decoded_file, vp);
+            GSource* source = g_timeout_source_new(1);
+            g_source_set_callback(source, cb_seek_decoded_file, vp, nullptr);
+            g_source_attach(source, vp->m_context);
+            g_source_unref(source);
         }
 
         switch(GST_EVENT_TYPE(event)) {
@@ -167,126 +525,623 @@ static GstPadProbeReturn cb_reset_stream_probe(
     return GST_PAD_PROBE_OK;
 }
 
-static void cb_decodebin_child_added(GstChildProxy* child_proxy, GObject* object,
-    gchar* name, gpointer user_data)
+static gboolean cb_segment_seek(gpointer user_data)
 {
     VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+    // only arming the loop flushes, every later loop runs on without a state change
+    GstSeekFlags flags = vp->m_loopArmed ? GST_SEEK_FLAG_SEGMENT :
+        (GstSeekFlags)(GST_SEEK_FLAG_SEGMENT | GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT);
 
-    LOG_INFO("cb_decodebin_child_added called({},'{}' added)", pipeline_id, name);
-
-    if (g_strrstr(name, "nvv4l2decoder") == name) {
-        g_object_set(object, "cudadec-memtype", 2, nullptr);
+    g_mutex_lock(&vp->m_mutex);
+    g_source_unref(vp->m_segmentSeekSource);
+    vp->m_segmentSeekSource = nullptr;
+    g_mutex_unlock(&vp->m_mutex);
 
-        if (g_strstr_len(vp->m_config.src_uri.c_str(), -1, "file:/") ==
-            vp->m_config.src_uri.c_str() && vp->m_config.file_loop) {
-            GstPad* gst_pad = gst_element_get_static_pad(GST_ELEMENT(object), "sink");
-            vp->m_dec_sink_probe = gst_pad_add_probe(gst_pad, (GstPadProbeType)(
-                GST_PAD_PROBE_TYPE_EVENT_BOTH | GST_PAD_PROBE_TYPE_EVENT_FLUSH |
-                GST_PAD_PROBE_TYPE_BUFFER), cb_reset_stream_probe, static_cast<void*>(vp), nullptr);
-            gst_object_unref(gst_pad);
+    LOG_DEBUG("Pipeline[{}]: segment seek to the start, flush: {}",
+        vp->m_config.pipeline_id, !vp->m_loopArmed);
 
-            vp->m_decoder = GST_ELEMENT(object);
-            gst_object_ref(object);
-        } else if (g_strstr_len(vp->m_config.src_uri.c_str(), -1, "rtsp:/") ==
-            vp->m_config.src_uri.c_str()) {
-            vp->m_decoder = GST_ELEMENT(object);
-            gst_object_ref(object);
-        }
-    } else if ((g_strrstr(name, "h264parse") == name) ||
-            (g_strrstr(name, "h265parse") == name)) {
-        LOG_INFO("set config-interval of {} to {}", name, -1);
-        g_object_set(object, "config-interval", -1, nullptr);
+    if (!gst_element_seek(vp->m_pipeline, 1.0, GST_FORMAT_TIME, flags,
+        GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE)) {
+        LOG_WARN("Pipeline[{}]: failed to segment seek the source file", vp->m_config.pipeline_id);
+    } else {
+        vp->m_loopArmed = true;
     }
 
-done:
-    return;
+    return G_SOURCE_REMOVE;
 }
 
-static void cb_uridecodebin_source_setup(GstElement* object, GstElement* source,
-    gpointer user_data)
+// destroyed by Destroy() if still pending, one at a time
+static void schedule_segment_seek(VideoPipeline* vp)
 {
-    LOG_INFO("cb_uridecodebin_source_setup called");
-    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+    g_mutex_lock(&vp->m_mutex);
 
-    if (g_object_class_find_property(G_OBJECT_GET_CLASS(source), "latency")) {
-        LOG_INFO("cb_uridecodebin_source_setup set {} latency", vp->m_config.rtsp_latency);
-        g_object_set(G_OBJECT(source), "latency", vp->m_config.rtsp_latency, nullptr);
+    if (!vp->m_segmentSeekSource && !vp->m_isExited) {
+        vp->m_segmentSeekSource = g_idle_source_new();
+        g_source_set_callback(vp->m_segmentSeekSource, cb_segment_seek, vp, nullptr);
+        g_source_attach(vp->m_segmentSeekSource, vp->m_context);
     }
 
-    if (g_object_class_find_property(G_OBJECT_GET_CLASS(source), "protocols")) {
-        LOG_INFO("set protocols of source to {}", vp->m_config.rtp_protocol);
-        g_object_set(G_OBJECT(source), "protocols", vp->m_config.rtp_protocol, nullptr);
+    g_mutex_unlock(&vp->m_mutex);
+}
+
+// the segment may start past its base, the offset is negative then
+static GstClockTime offset_time(GstClockTime time, int64_t offset)
+{
+    if (offset < 0 && time < (GstClockTime)-offset) {
+        return 0;
     }
+
+    return time + offset;
 }
 
-static void cb_uridecodebin_pad_added(GstElement* decodebin, GstPad* pad,
+/*
+ * Gapless loop: the file plays as a segment seek, the demuxer sends
+ * SEGMENT_DONE instead of EOS at its end and restarts without flushing.
+ * Its new segment carries the accumulated running time in base, which is
+ * moved into the timestamps, so PTS keep growing across loops like they
+ * do with cb_reset_stream_probe.
+ */
+static GstPadProbeReturn cb_segment_loop_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
     gpointer user_data)
 {
     VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
-    GstPad* sinkpad = nullptr;
 
-    GstCaps* caps = gst_pad_query_caps(pad, nullptr);
-    const GstStructure* str = gst_caps_get_structure(caps, 0);
-    const gchar* name = gst_structure_get_name(str);
-    
-    LOG_INFO("cb_uridecodebin_pad_added called {}", name);
-    LOG_INFO("structure:{}", gst_structure_to_string(str));
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
 
-    if (g_str_has_prefix (name, "video/x-raw")) {
-        if (vp->m_config.enable_hdmi || vp->m_config.enable_rtmp || vp->m_config.enable_appsink) {
-            sinkpad = gst_element_get_static_pad(vp->m_tee0, "sink");
-        } else {
-            sinkpad = gst_element_get_static_pad(vp->m_fakesink, "sink");
+        if (!vp->m_loopSeeking) {
+            vp->m_loopSeeking = true;
+            schedule_segment_seek(vp);
         }
 
-        if (sinkpad && gst_pad_link(pad, sinkpad) == GST_PAD_LINK_OK) {
-            LOG_INFO("Success to link uridecodebin into pipeline");
-        } else {
-            LOG_ERROR("Failed to link uridecodebin to pipeline");
+        if (vp->m_loopOffset) {
+            buffer = gst_buffer_make_writable(buffer);
+            if (GST_BUFFER_PTS_IS_VALID(buffer)) {
+                GST_BUFFER_PTS(buffer) = offset_time(GST_BUFFER_PTS(buffer), vp->m_loopOffset);
+            }
+            if (GST_BUFFER_DTS_IS_VALID(buffer)) {
+                GST_BUFFER_DTS(buffer) = offset_time(GST_BUFFER_DTS(buffer), vp->m_loopOffset);
+            }
+            GST_PAD_PROBE_INFO_DATA(info) = buffer;
         }
 
-        if (sinkpad) {
-            gst_object_unref(sinkpad);
-        }
+        return GST_PAD_PROBE_OK;
     }
 
-    gst_caps_unref(caps);
-}
+    GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+    switch (GST_EVENT_TYPE(event)) {
+        case GST_EVENT_SEGMENT: {
+            const GstSegment* segment;
+            GstSegment rebased;
+            GstEvent* new_event;
 
-static void cb_uridecodebin_child_added(GstChildProxy* child_proxy,
-    GObject* object, gchar* name, gpointer user_data)
-{
-    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+            gst_event_parse_segment(event, &segment);
+            if (segment->format != GST_FORMAT_TIME) {
+                break;
+            }
 
-    LOG_INFO("cb_uridecodebin_child_added called({},'{}' added)", pipeline_id, name);
+            // same running time, with base folded into the timestamps
+            gst_segment_copy_into(segment, &rebased);
+            vp->m_loopOffset = (int64_t)segment->base - (int64_t)segment->start;
+            rebased.start = 0;
+            rebased.position = 0;
+            if (GST_CLOCK_TIME_IS_VALID(segment->stop)) {
+                rebased.stop = offset_time(segment->stop, vp->m_loopOffset);
+            }
+            rebased.base = 0;
 
-    if (g_strrstr(name, "decodebin") == name) {
-        g_signal_connect(G_OBJECT(object), "child-added",
-            G_CALLBACK(cb_decodebin_child_added), vp);
+            new_event = gst_event_new_segment(&rebased);
+            gst_event_set_seqnum(new_event, gst_event_get_seqnum(event));
+            gst_event_unref(event);
+            GST_PAD_PROBE_INFO_DATA(info) = new_event;
+            break;
+        }
+        case GST_EVENT_SEGMENT_DONE:
+            schedule_segment_seek(vp);
+            return GST_PAD_PROBE_DROP;
+        case GST_EVENT_EOS:
+            // the loop isn't armed yet, arm it now
+            if (vp->m_loopArmed) {
+                break;
+            }
+            schedule_segment_seek(vp);
+            return GST_PAD_PROBE_DROP;
+        default:
+            break;
     }
 
-done:
-    return;
+    return GST_PAD_PROBE_OK;
 }
 
-VideoPipeline::VideoPipeline(const VideoPipelineConfig& config)
+// parsed stream of uridecodebin to the appsrc of the passthrough rtmp branch
+static GstPadProbeReturn cb_passthrough_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
 {
-    m_config = config;
-    m_syncCount = 0;
-    m_isExited = false;
-    m_queue00_src_probe = -1;
-    m_cvt_sink_probe = -1;
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+    GstAppSrc* appsrc = vp->m_rtmpsrc ? GST_APP_SRC(vp->m_rtmpsrc) : nullptr;
+
+    if (!appsrc) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+        GstCaps* caps;
+        const GstSegment* segment;
+
+        switch (GST_EVENT_TYPE(event)) {
+            case GST_EVENT_CAPS:
+                gst_event_parse_caps(event, &caps);
+                // flvmux only takes H.264
+                vp->m_passthroughH264 = gst_structure_has_name(
+                    gst_caps_get_structure(caps, 0), "video/x-h264");
+                if (vp->m_passthroughH264) {
+                    gst_app_src_set_caps(appsrc, caps);
+                } else {
+                    LOG_WARN("Pipeline[{}]: rtmp passthrough needs H.264, got {}",
+                        vp->m_config.pipeline_id, gst_structure_get_name(gst_caps_get_structure(caps, 0)));
+                }
+                break;
+            case GST_EVENT_SEGMENT:
+                gst_event_parse_segment(event, &segment);
+                gst_segment_copy_into(segment, &vp->m_passthroughSegment);
+                vp->m_passthroughNewSegment = true;
+                break;
+            case GST_EVENT_EOS:
+                // a looped file goes on with the next segment
+                if (!vp->m_config.file_loop) {
+                    gst_app_src_end_of_stream(appsrc);
+                }
+                break;
+            default:
+                break;
+        }
+
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstClockTime pts = GST_BUFFER_PTS(buffer), dts = GST_BUFFER_DTS_OR_PTS(buffer);
+
+    if (!vp->m_passthroughH264) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    // running time, B-frames may be decoded before the segment starts
+    if (GST_CLOCK_TIME_IS_VALID(pts) && gst_segment_to_running_time_full(
+        &vp->m_passthroughSegment, GST_FORMAT_TIME, pts, &pts) < 0) {
+        pts = 0;
+    }
+    if (GST_CLOCK_TIME_IS_VALID(dts) && gst_segment_to_running_time_full(
+        &vp->m_passthroughSegment, GST_FORMAT_TIME, dts, &dts) < 0) {
+        dts = 0;
+    }
+
+    // restarted after a flushing seek, a loop or a reconnect, flvmux needs DTS to go on
+    if (vp->m_passthroughNewSegment && GST_CLOCK_TIME_IS_VALID(dts)) {
+        if (GST_CLOCK_TIME_IS_VALID(vp->m_passthroughLastDts) &&
+            dts + vp->m_passthroughBase <= vp->m_passthroughLastDts) {
+            vp->m_passthroughBase = vp->m_passthroughLastDts - dts + (GST_BUFFER_DURATION_IS_VALID(buffer) ?
+                GST_BUFFER_DURATION(buffer) : GST_MSECOND);
+        }
+        vp->m_passthroughNewSegment = false;
+    }
+
+    // the stream can only be resumed from a keyframe once something was dropped
+    if (vp->m_config.queue11.max_bytes && gst_app_src_get_current_level_bytes(appsrc) >=
+        vp->m_config.queue11.max_bytes) {
+        vp->m_passthroughWaitKey = true;
+        vp->m_queue11_dropped++;
+        return GST_PAD_PROBE_OK;
+    }
+    if (vp->m_passthroughWaitKey) {
+        if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+            vp->m_queue11_dropped++;
+            return GST_PAD_PROBE_OK;
+        }
+        vp->m_passthroughWaitKey = false;
+    }
+
+    // memory is shared with the buffer going on to the decoder
+    buffer = gst_buffer_copy(buffer);
+    GST_BUFFER_PTS(buffer) = GST_CLOCK_TIME_IS_VALID(pts) ? pts + vp->m_passthroughBase : pts;
+    GST_BUFFER_DTS(buffer) = GST_CLOCK_TIME_IS_VALID(dts) ? dts + vp->m_passthroughBase : dts;
+    if (GST_BUFFER_DTS_IS_VALID(buffer)) {
+        vp->m_passthroughLastDts = GST_BUFFER_DTS(buffer);
+    }
+    gst_app_src_push_buffer(appsrc, buffer);
+
+    return GST_PAD_PROBE_OK;
+}
+
+static void cb_decodebin_child_added(GstChildProxy* child_proxy, GObject* object,
+    gchar* name, gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+
+    LOG_INFO("cb_decodebin_child_added called({},'{}' added)", vp->m_config.pipeline_id, name);
+
+    if (g_strrstr(name, vp->m_backend->decoder) == name) {
+        if (vp->m_backend->type == BACKEND_NVIDIA) {
+            g_object_set(object, "cudadec-memtype", 2, nullptr);
+        }
+
+        if (vp->m_config.enable_latency_trace) {
+            add_latency_probe(GST_ELEMENT(object), "src", cb_latency_stamp_probe, vp);
+        }
+
+        // a batch has one decoder per source, seek and reconnect are single source only
+        if (!vp->m_config.batch_sources.empty()) {
+            goto done;
+        }
+
+        if (g_strstr_len(vp->m_config.src_uri.c_str(), -1, "file:/") ==
+            vp->m_config.src_uri.c_str() && vp->m_config.file_loop) {
+            GstPad* gst_pad = gst_element_get_static_pad(GST_ELEMENT(object), "sink");
+            if (vp->m_config.gapless_loop) {
+                vp->m_dec_sink_probe = gst_pad_add_probe(gst_pad, (GstPadProbeType)(
+                    GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_BUFFER),
+                    cb_segment_loop_probe, static_cast<void*>(vp), nullptr);
+            } else {
+                vp->m_dec_sink_probe = gst_pad_add_probe(gst_pad, (GstPadProbeType)(
+                    GST_PAD_PROBE_TYPE_EVENT_BOTH | GST_PAD_PROBE_TYPE_EVENT_FLUSH |
+                    GST_PAD_PROBE_TYPE_BUFFER), cb_reset_stream_probe, static_cast<void*>(vp), nullptr);
+            }
+            gst_object_unref(gst_pad);
+
+            vp->m_decoder = GST_ELEMENT(object);
+            gst_object_ref(object);
+        } else if (g_strstr_len(vp->m_config.src_uri.c_str(), -1, "rtsp:/") ==
+            vp->m_config.src_uri.c_str()) {
+            vp->m_decoder = GST_ELEMENT(object);
+            gst_object_ref(object);
+        }
+    } else if ((g_strrstr(name, "h264parse") == name) ||
+            (g_strrstr(name, "h265parse") == name)) {
+        LOG_INFO("set config-interval of {} to {}", name, -1);
+        g_object_set(object, "config-interval", -1, nullptr);
+
+        // a rebuilt uridecodebin comes with a new parser
+        if (vp->PassthroughEnabled()) {
+            GstPad* gst_pad = gst_element_get_static_pad(GST_ELEMENT(object), "src");
+            gst_pad_add_probe(gst_pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER |
+                GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM), cb_passthrough_probe,
+                static_cast<void*>(vp), nullptr);
+            gst_object_unref(gst_pad);
+        }
+    }
+
+done:
+    return;
+}
+
+static GstPadProbeReturn cb_source_alive_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        vp->m_lastBufferTime = g_get_monotonic_time();
+        if (vp->m_reconnectAttempts.exchange(0)) {
+            LOG_INFO("Pipeline[{}]: source recovered", vp->m_config.pipeline_id);
+        }
+    } else if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS) {
+        // a dropped camera must not end the branches behind tee0
+        vp->ScheduleReconnect("end of stream");
+        return GST_PAD_PROBE_DROP;
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstBusSyncReply cb_source_bus_sync(GstBus* bus, GstMessage* msg, gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+    GstObject* top = nullptr;
+    GError* error = nullptr;
+
+    if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_ERROR) {
+        return GST_BUS_PASS;
+    }
+
+    // the child of the pipeline the error comes from, a replaced source has no parent
+    for (GstObject* object = GST_MESSAGE_SRC(msg);
+        object && object != GST_OBJECT(vp->m_pipeline); object = GST_OBJECT_PARENT(object)) {
+        top = object;
+    }
+    if (!top || !g_str_has_prefix(GST_OBJECT_NAME(top), "uridecodebin")) {
+        return GST_BUS_PASS;
+    }
+
+    // handled here, so the owner of the bus doesn't restart the whole pipeline
+    gst_message_parse_error(msg, &error, nullptr);
+    vp->ScheduleReconnect(std::string("error from ") + GST_OBJECT_NAME(GST_MESSAGE_SRC(msg)) +
+        ": " + error->message);
+    g_clear_error(&error);
+    gst_message_unref(msg);
+
+    return GST_BUS_DROP;
+}
+
+static gboolean cb_source_watchdog(gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+    int64_t idle = (g_get_monotonic_time() - vp->m_lastBufferTime) / 1000;
+
+    // a paused pipeline is not stalled
+    if (GST_STATE(vp->m_pipeline) != GST_STATE_PLAYING) {
+        vp->m_lastBufferTime = g_get_monotonic_time();
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (idle > vp->m_config.reconnect_timeout) {
+        vp->ScheduleReconnect("no buffer for " + std::to_string(idle) + "ms");
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean cb_osd_delay(gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+
+    g_mutex_lock(&vp->m_mutex);
+    g_source_unref(vp->m_osdDelaySource);
+    vp->m_osdDelaySource = nullptr;
+    if (!vp->m_isExited) {
+        vp->ApplyOsdDelay();
+    }
+    g_mutex_unlock(&vp->m_mutex);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean cb_reconnect_source(gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+
+    vp->RebuildSource();
+
+    g_mutex_lock(&vp->m_mutex);
+    g_source_unref(vp->m_reconnectSource);
+    vp->m_reconnectSource = nullptr;
+    g_mutex_unlock(&vp->m_mutex);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void cb_uridecodebin_source_setup(GstElement* object, GstElement* source,
+    gpointer user_data)
+{
+    LOG_INFO("cb_uridecodebin_source_setup called");
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(source), "latency")) {
+        LOG_INFO("cb_uridecodebin_source_setup set {} latency", vp->m_config.rtsp_latency);
+        g_object_set(G_OBJECT(source), "latency", vp->m_config.rtsp_latency, nullptr);
+    }
+
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(source), "protocols")) {
+        LOG_INFO("set protocols of source to {}", vp->m_config.rtp_protocol);
+        g_object_set(G_OBJECT(source), "protocols", vp->m_config.rtp_protocol, nullptr);
+    }
+}
+
+static void cb_uridecodebin_pad_added(GstElement* decodebin, GstPad* pad,
+    gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+    GstPad* sinkpad = nullptr;
+    GstPad* batch_sinkpad = static_cast<GstPad*>(
+        g_object_get_data(G_OBJECT(decodebin), "batch-sinkpad"));
+
+    GstCaps* caps = gst_pad_query_caps(pad, nullptr);
+    const GstStructure* str = gst_caps_get_structure(caps, 0);
+    const gchar* name = gst_structure_get_name(str);
+    
+    LOG_INFO("cb_uridecodebin_pad_added called {}", name);
+    LOG_INFO("structure:{}", gst_structure_to_string(str));
+
+    if (g_str_has_prefix (name, "video/x-raw")) {
+        if (batch_sinkpad) {
+            sinkpad = static_cast<GstPad*>(gst_object_ref(batch_sinkpad));
+        } else {
+            // branches may be attached later, tee0 is always there
+            sinkpad = gst_element_get_static_pad(vp->m_tee0, "sink");
+        }
+
+        if (sinkpad && gst_pad_link(pad, sinkpad) == GST_PAD_LINK_OK) {
+            LOG_INFO("Success to link uridecodebin into pipeline");
+        } else {
+            LOG_ERROR("Failed to link uridecodebin to pipeline");
+        }
+
+        if (sinkpad) {
+            gst_object_unref(sinkpad);
+        }
+    }
+
+    gst_caps_unref(caps);
+}
+
+static void cb_uridecodebin_child_added(GstChildProxy* child_proxy,
+    GObject* object, gchar* name, gpointer user_data)
+{
+    VideoPipeline* vp = static_cast<VideoPipeline*>(user_data);
+
+    LOG_INFO("cb_uridecodebin_child_added called({},'{}' added)", vp->m_config.pipeline_id, name);
+
+    if (g_strrstr(name, "decodebin") == name) {
+        g_signal_connect(G_OBJECT(object), "child-added",
+            G_CALLBACK(cb_decodebin_child_added), vp);
+    }
+
+done:
+    return;
+}
+
+/* detach of one branch, from the idle probe on its tee pad to the main context */
+struct BranchRemoval {
+    GstElement*                 pipeline;
+    GMainContext*               context;    /* nullptr for the default one */
+    GstElement*                 tee;
+    GstPad*                     teepad;
+    std::vector<GstElement*>    elements;   /* upstream first */
+    const char*                 name;
+    gint                        unlinked;
+};
+
+static gboolean cb_remove_branch(gpointer user_data)
+{
+    BranchRemoval* removal = static_cast<BranchRemoval*>(user_data);
+
+    // holds its own references, so it's safe after the VideoPipeline is gone
+    for (GstElement* element : removal->elements) {
+        gst_element_set_state(element, GST_STATE_NULL);
+        gst_bin_remove(GST_BIN(removal->pipeline), element);
+        gst_object_unref(element);
+    }
+
+    // Destroy() may have released it already
+    if (GST_PAD_PARENT(removal->teepad) == GST_OBJECT(removal->tee)) {
+        gst_element_release_request_pad(removal->tee, removal->teepad);
+    }
+
+    LOG_INFO("Pipeline[{}]: {} branch detached", GST_ELEMENT_NAME(removal->pipeline),
+        removal->name);
+
+    gst_object_unref(removal->teepad);
+    gst_object_unref(removal->tee);
+    gst_object_unref(removal->pipeline);
+    if (removal->context) {
+        g_main_context_unref(removal->context);
+    }
+    delete removal;
+
+    return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn cb_unlink_branch_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    BranchRemoval* removal = static_cast<BranchRemoval*>(user_data);
+
+    // idle probes may fire again before the first one returned
+    if (!g_atomic_int_compare_and_exchange(&removal->unlinked, FALSE, TRUE)) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    // nothing is being pushed on the pad, the branch only misses what comes next
+    GstPad* sinkpad = gst_element_get_static_pad(removal->elements.front(), "sink");
+    gst_pad_unlink(removal->teepad, sinkpad);
+    gst_object_unref(sinkpad);
+
+    // elements can't be stopped from their own streaming thread
+    GSource* source = g_idle_source_new();
+    g_source_set_callback(source, cb_remove_branch, removal, nullptr);
+    g_source_attach(source, removal->context);
+    g_source_unref(source);
+
+    return GST_PAD_PROBE_REMOVE;
+}
+
+VideoPipeline::VideoPipeline(const VideoPipelineConfig& config,
+    GMainContext* context) :
+    m_samplePool(config.sample_pool_size),
+    m_queue00_dropped(0),
+    m_queue01_dropped(0),
+    m_queue10_dropped(0),
+    m_queue11_dropped(0),
+    m_rateController(config.infer_fps, config.adaptive_infer),
+    m_multiScaler(config.infer_outputs),
+    m_delayLine((int64_t)config.osd_min_delay * GST_MSECOND,
+        (int64_t)config.osd_max_delay * GST_MSECOND, config.osd_delay_percentile)
+{
+    m_config = config;
+    m_backend = &GetBackendProfile(config.backend);
+    m_scaledFrameFuncs.resize(config.infer_outputs.size());
+    m_cropFrameWidth = 0;
+    m_cropFrameHeight = 0;
+    m_inferPrescale = false;
+    if (!parse_crop(config.crop, m_crop)) {
+        LOG_WARN("Pipeline[{}]: invalid crop {}, the whole frame is inferred",
+            config.pipeline_id, config.crop);
+    }
+    m_context = context ? g_main_context_ref(context) : nullptr;
+    m_syncCount = 0;
+    m_isExited = false;
+    m_queue00_src_probe = -1;
+    m_cvt_sink_probe = -1;
     m_cvt_src_probe = -1;
     m_dec_sink_probe = -1;
     m_prev_accumulated_base = 0;
     m_accumulated_base = 0;
+    m_loopOffset = 0;
+    m_loopSeeking = false;
+    m_loopArmed = false;
+    m_segmentSeekSource = nullptr;
     m_dumped = false;
+    m_latencyDumpSource = nullptr;
+    m_lastBufferTime = 0;
+    m_startTime = 0;
+    m_timeToFirstFrame = -1;
+    m_warmStart = false;
+    m_reconnectAttempts = 0;
+    m_watchdogSource = nullptr;
+    m_reconnectSource = nullptr;
+    m_osdDelaySource = nullptr;
+    m_passthroughH264 = false;
+    m_passthroughNewSegment = false;
+    m_passthroughWaitKey = true;
+    m_passthroughBase = 0;
+    m_passthroughLastDts = GST_CLOCK_TIME_NONE;
+    gst_segment_init(&m_passthroughSegment, GST_FORMAT_TIME);
+
+    m_pipeline = nullptr;
+    m_source = nullptr;
+    m_streammuxer = nullptr;
+    m_tiler = nullptr;
+    m_capfilter0 = nullptr;
+    m_decoder = nullptr;
+    m_tee0 = nullptr;
+    m_queue00 = nullptr;
+    m_fakesink = nullptr;
+    m_tee1 = nullptr;
+    m_queue10 = nullptr;
+    m_nveglglessink = nullptr;
+    m_queue11 = nullptr;
+    m_rtmpsrc = nullptr;
+    m_nvvideoconvert0 = nullptr;
+    m_capfilter1 = nullptr;
+    m_encoder = nullptr;
+    m_h264parse = nullptr;
+    m_flvmux = nullptr;
+    m_rtmpsink = nullptr;
+    m_queue01 = nullptr;
+    m_videocrop = nullptr;
+    m_nvvideoconvert1 = nullptr;
+    m_videoscale = nullptr;
+    m_capfilter2 = nullptr;
+    m_appsink = nullptr;
 
     m_putFrameFunc = nullptr;
     m_putFrameArgs = nullptr;
     m_getResultFunc = nullptr;
     m_getResultArgs = nullptr;
+    m_getPtsResultFunc = nullptr;
+    m_getPtsResultArgs = nullptr;
+    m_getBatchResultFunc = nullptr;
+    m_getBatchResultArgs = nullptr;
     m_procResultFunc = nullptr;
+    m_procBatchResultFunc = nullptr;
 
     g_mutex_init(&m_syncMuxtex);
     g_cond_init(&m_syncCondition);
@@ -296,28 +1151,40 @@ VideoPipeline::VideoPipeline(const VideoPipelineConfig& config)
 VideoPipeline::~VideoPipeline()
 {
     Destroy();
+
+    g_mutex_clear(&m_mutex);
+    g_mutex_clear(&m_syncMuxtex);
+    g_cond_clear(&m_syncCondition);
+
+    if (m_context) {
+        g_main_context_unref(m_context);
+        m_context = nullptr;
+    }
 }
 
-GstElement* VideoPipeline::CreateUridecodebin()
+GstElement* VideoPipeline::CreateUridecodebin(const std::string& uri, int index)
 {
-    if (!(m_source = gst_element_factory_make("uridecodebin", "uridecodebin0"))) {
-        LOG_ERROR("Failed to create element uridecodebin named uridecodebin0");
+    GstElement* source;
+    std::string name = "uridecodebin" + std::to_string(index);
+
+    if (!(source = gst_element_factory_make("uridecodebin", name.c_str()))) {
+        LOG_ERROR("Failed to create element uridecodebin named {}", name);
         return nullptr;
     }
 
-    g_object_set (G_OBJECT(m_source), "uri", m_config.src_uri.c_str(), nullptr);
-    LOG_INFO("Set uri of uridecodebin to {}", m_config.src_uri);
+    g_object_set (G_OBJECT(source), "uri", uri.c_str(), nullptr);
+    LOG_INFO("Set uri of {} to {}", name, uri);
 
-    g_signal_connect(G_OBJECT(m_source), "source-setup", G_CALLBACK(
+    g_signal_connect(G_OBJECT(source), "source-setup", G_CALLBACK(
         cb_uridecodebin_source_setup), this);
-    g_signal_connect(G_OBJECT(m_source), "pad-added",    G_CALLBACK(
+    g_signal_connect(G_OBJECT(source), "pad-added",    G_CALLBACK(
         cb_uridecodebin_pad_added),    this);
-    g_signal_connect(G_OBJECT(m_source), "child-added",  G_CALLBACK(
+    g_signal_connect(G_OBJECT(source), "child-added",  G_CALLBACK(
         cb_uridecodebin_child_added),  this);
 
-    gst_bin_add_many(GST_BIN(m_pipeline), m_source, nullptr);
+    gst_bin_add_many(GST_BIN(m_pipeline), source, nullptr);
 
-    return m_source;
+    return source;
 }
 
 GstElement* VideoPipeline::CreateV4l2src()
@@ -350,6 +1217,8 @@ GstElement* VideoPipeline::CreateV4l2src()
         return nullptr;
     }
     gst_bin_add_many(GST_BIN(m_pipeline), m_decoder, nullptr);
+    // m_decoder always holds its own reference, like the one of uridecodebin
+    gst_object_ref(m_decoder);
 
     if (!gst_element_link_many(m_source, m_capfilter0, m_decoder, nullptr)) {
         LOG_ERROR("Failed to link v4l2src0->capfilter0->nvjpegdec0");
@@ -359,21 +1228,500 @@ GstElement* VideoPipeline::CreateV4l2src()
     return m_decoder;
 }
 
-bool VideoPipeline::Create()
+GstElement* VideoPipeline::CreateStreammux()
+{
+    bool cpu_muxer = m_config.batch_muxer == "cpubatchmux";
+    guint batch_size = m_config.batch_sources.size();
+
+    if (cpu_muxer && !gst_cpu_batch_mux_register()) {
+        LOG_ERROR("Failed to register element cpubatchmux");
+        return nullptr;
+    }
+
+    if (!(m_streammuxer = gst_element_factory_make(m_config.batch_muxer.c_str(), "streammuxer0"))) {
+        LOG_ERROR("Failed to create element {} named streammuxer0", m_config.batch_muxer);
+        return nullptr;
+    }
+
+    if (cpu_muxer) {
+        // latency of the aggregator is how long live sources are waited for
+        g_object_set(G_OBJECT(m_streammuxer), "batch-size", batch_size,
+            "latency", (guint64)m_config.batch_timeout * GST_USECOND, nullptr);
+    } else {
+        g_object_set(G_OBJECT(m_streammuxer), "batch-size", batch_size,
+            "width", m_config.batch_width, "height", m_config.batch_height,
+            "batched-push-timeout", m_config.batch_timeout,
+            "live-source", m_config.batch_live_source,
+            "nvbuf-memory-type", m_config.cvt_memory_type, nullptr);
+    }
+    gst_bin_add_many(GST_BIN(m_pipeline), m_streammuxer, nullptr);
+
+    LOG_INFO("Batch {} sources with {}", batch_size, m_config.batch_muxer);
+
+    for (const VideoSourceConfig& config : m_config.batch_sources) {
+        GstElement* source;
+        GstPad* sinkpad;
+        std::string pad_name = "sink_" + std::to_string(config.source_id);
+
+        if (!(source = CreateUridecodebin(config.src_uri, config.source_id))) {
+            return nullptr;
+        }
+
+        if (!(sinkpad = gst_element_get_request_pad(m_streammuxer, pad_name.c_str()))) {
+            LOG_ERROR("Failed to request pad {} of {}", pad_name, m_config.batch_muxer);
+            return nullptr;
+        }
+
+        if (cpu_muxer) {
+            // software decoded frames are converted before batching
+            GstElement* convert;
+            GstElement* capfilter;
+            GstCaps* caps;
+            GstPad* srcpad;
+            std::string convert_name = "videoconvert" + std::to_string(config.source_id);
+            std::string capfilter_name = "batchcapfilter" + std::to_string(config.source_id);
+
+            if (!(convert = gst_element_factory_make("videoconvert", convert_name.c_str())) ||
+                !(capfilter = gst_element_factory_make("capsfilter", capfilter_name.c_str()))) {
+                LOG_ERROR("Failed to create converter of source {}", config.source_id);
+                gst_object_unref(sinkpad);
+                return nullptr;
+            }
+
+            caps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, m_config.cvt_format.c_str(), nullptr);
+            g_object_set(G_OBJECT(capfilter), "caps", caps, nullptr);
+            gst_caps_unref(caps);
+
+            gst_bin_add_many(GST_BIN(m_pipeline), convert, capfilter, nullptr);
+
+            srcpad = gst_element_get_static_pad(capfilter, "src");
+            if (!gst_element_link(convert, capfilter) ||
+                gst_pad_link(srcpad, sinkpad) != GST_PAD_LINK_OK) {
+                LOG_ERROR("Failed to link {}->{}->{}", convert_name, capfilter_name, pad_name);
+                gst_object_unref(srcpad);
+                gst_object_unref(sinkpad);
+                return nullptr;
+            }
+            gst_object_unref(srcpad);
+            gst_object_unref(sinkpad);
+
+            sinkpad = gst_element_get_static_pad(convert, "sink");
+        }
+
+        // linked in cb_uridecodebin_pad_added once the stream is decoded
+        g_object_set_data_full(G_OBJECT(source), "batch-sinkpad", sinkpad,
+            (GDestroyNotify)gst_object_unref);
+    }
+
+    return m_streammuxer;
+}
+
+std::vector<GstElement*> VideoPipeline::BranchElements(OutputBranch branch)
+{
+    std::vector<GstElement*> elements;
+    std::vector<GstElement*> candidates;
+
+    switch (branch) {
+        case DISPLAY_BRANCH:
+            candidates = { m_queue10, m_nveglglessink };
+            break;
+        case RTMP_BRANCH:
+            candidates = { m_rtmpsrc, m_queue11, m_nvvideoconvert0, m_capfilter1,
+                m_encoder, m_h264parse, m_flvmux, m_rtmpsink };
+            break;
+        case INFERENCE_BRANCH:
+            candidates = { m_queue01, m_videocrop, m_nvvideoconvert1, m_videoscale,
+                m_capfilter2, m_appsink };
+            break;
+        default:
+            break;
+    }
+
+    for (GstElement* element : candidates) {
+        if (element) {
+            elements.push_back(element);
+        }
+    }
+
+    return elements;
+}
+
+void VideoPipeline::ClearBranch(OutputBranch branch)
+{
+    switch (branch) {
+        case DISPLAY_BRANCH:
+            m_queue10 = m_nveglglessink = nullptr;
+            m_config.enable_hdmi = false;
+            break;
+        case RTMP_BRANCH:
+            m_rtmpsrc = m_queue11 = m_nvvideoconvert0 = m_capfilter1 = m_encoder = nullptr;
+            m_h264parse = m_flvmux = m_rtmpsink = nullptr;
+            m_config.enable_rtmp = false;
+            // an attached branch starts over with new timestamps
+            if (m_recorder) {
+                m_recorder->Reset();
+            }
+            break;
+        case INFERENCE_BRANCH: {
+            // the rate and crop probes go away with their elements
+            std::lock_guard<std::mutex> lock(m_cropMutex);
+            m_queue01 = m_videocrop = m_nvvideoconvert1 = m_videoscale = nullptr;
+            m_capfilter2 = m_appsink = nullptr;
+            m_cropFrameWidth = m_cropFrameHeight = 0;
+            m_inferSize = m_inferRef = cv::Size();
+            m_cvt_sink_probe = -1;
+            m_config.enable_appsink = false;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool VideoPipeline::LinkBranch(GstElement* tee, const std::vector<GstElement*>& elements)
+{
+    // nothing to do before Start(), otherwise downstream first, so the head
+    // never pushes into an element that isn't running yet
+    for (auto it = elements.rbegin(); it != elements.rend(); ++it) {
+        if (!gst_element_sync_state_with_parent(*it)) {
+            LOG_ERROR("Failed to sync state of {}", GST_ELEMENT_NAME(*it));
+            return false;
+        }
+    }
+
+    // linked last, tee resends stream-start, caps and segment to the new pad
+    if (tee && !gst_element_link(tee, elements.front())) {
+        LOG_ERROR("Failed to link {}->{}", GST_ELEMENT_NAME(tee),
+            GST_ELEMENT_NAME(elements.front()));
+        return false;
+    }
+
+    return true;
+}
+
+bool VideoPipeline::CreateDisplayBranch()
+{
+    std::string name;
+
+    if (!(m_queue10 = gst_element_factory_make("queue", "queue10"))) {
+        LOG_ERROR("Failed to create element queue named queue10");
+        return false;
+    }
+    configure_queue(m_queue10, m_config.queue10, &m_queue10_dropped);
+    gst_bin_add_many(GST_BIN(m_pipeline), m_queue10, nullptr);
+
+    name = std::string(m_backend->display) + "0";
+    if (!(m_nveglglessink = gst_element_factory_make(m_backend->display, name.c_str()))) {
+        LOG_ERROR("Failed to create element {} named {}", m_backend->display, name);
+        return false;
+    }
+    configure_display(m_nveglglessink, m_config);
+    configure_sink_delay(m_nveglglessink, m_delayLine.Delay());
+
+    gst_bin_add_many(GST_BIN(m_pipeline), m_nveglglessink, nullptr);
+
+    if (m_config.enable_latency_trace) {
+        add_latency_probe(m_nveglglessink, "sink", cb_display_latency_probe, this);
+    }
+
+    if (!gst_element_link_many(m_queue10, m_nveglglessink, nullptr)) {
+        LOG_ERROR("Failed to link queue10->{}", name);
+        return false;
+    }
+
+    return LinkBranch(m_tee1, BranchElements(DISPLAY_BRANCH));
+}
+
+bool VideoPipeline::CreateRtmpBranch()
 {
     GstCaps* cvt_caps;
-    GstPad* gst_pad;
     GstCapsFeatures* feature;
-    GstElement* input;
+    std::string name;
+
+    if (PassthroughEnabled()) {
+        if (!(m_rtmpsrc = gst_element_factory_make("appsrc", "rtmpsrc0"))) {
+            LOG_ERROR("Failed to create element appsrc named rtmpsrc0");
+            return false;
+        }
+        // runs its own streaming thread and never blocks the decoder, caps come with the stream
+        g_object_set(G_OBJECT(m_rtmpsrc), "format", GST_FORMAT_TIME,
+            "is-live", g_str_has_prefix(m_config.src_uri.c_str(), "rtsp://"),
+            "max-bytes", (guint64)m_config.queue11.max_bytes,
+            "block", false, nullptr);
+        gst_bin_add_many(GST_BIN(m_pipeline), m_rtmpsrc, nullptr);
+        m_passthroughWaitKey = true;
+    } else {
+        if (!(m_queue11 = gst_element_factory_make("queue", "queue11"))) {
+            LOG_ERROR("Failed to create element queue named queue11");
+            return false;
+        }
+        configure_queue(m_queue11, m_config.queue11, &m_queue11_dropped);
+        gst_bin_add_many(GST_BIN(m_pipeline), m_queue11, nullptr);
+
+        name = std::string(m_backend->converter) + "0";
+        if (!(m_nvvideoconvert0 = gst_element_factory_make(m_backend->converter, name.c_str()))) {
+            LOG_ERROR("Failed to create element {} named {}", m_backend->converter, name);
+            return false;
+        }
+        if (m_backend->type == BACKEND_NVIDIA) {
+            g_object_set(G_OBJECT(m_nvvideoconvert0), "nvbuf-memory-type", m_config.cvt_memory_type, nullptr);
+        }
+        gst_bin_add_many(GST_BIN(m_pipeline), m_nvvideoconvert0, nullptr);
+
+        if (!(m_capfilter1 = gst_element_factory_make("capsfilter", "capfilter1"))) {
+            LOG_ERROR("Failed to create element capsfilter named capfilter1");
+            return false;
+        }
+
+        // x264enc takes I420 only
+        cvt_caps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING,
+            m_backend->type == BACKEND_SOFTWARE ? "I420" : "NV12", nullptr);
+        if (m_backend->memory) {
+            feature = gst_caps_features_new(m_backend->memory, nullptr);
+            gst_caps_set_features(cvt_caps, 0, feature);
+        }
+
+        g_object_set(G_OBJECT(m_capfilter1), "caps", cvt_caps, nullptr);
+        gst_caps_unref(cvt_caps);
+
+        gst_bin_add_many(GST_BIN(m_pipeline), m_capfilter1, nullptr);
+
+        name = std::string(m_backend->encoder) + "0";
+        if (!(m_encoder = gst_element_factory_make(m_backend->encoder, name.c_str()))) {
+            LOG_ERROR("Failed to create element {} named {}", m_backend->encoder, name);
+            return false;
+        }
+        configure_encoder(m_encoder, m_backend, m_config.enc_bitrate, m_config.enc_iframe_interval);
+        gst_bin_add_many(GST_BIN(m_pipeline), m_encoder, nullptr);
+
+        // frames are gone once encoded, the rtmp branch ends at the encoder
+        if (m_config.enable_latency_trace) {
+            add_latency_probe(m_encoder, "sink", cb_rtmp_latency_probe, this);
+        }
+    }
+
+    if (!(m_h264parse = gst_element_factory_make("h264parse", "h264parse0"))) {
+        LOG_ERROR("Failed to create element h264parse named h264parse0");
+        return false;
+    }
+    gst_bin_add_many(GST_BIN(m_pipeline), m_h264parse, nullptr);
+
+    // the same access units flvmux gets, encoded or passthrough
+    if (m_recorder) {
+        GstPad* pad = gst_element_get_static_pad(m_h264parse, "src");
+        gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER |
+            GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM), cb_record_probe,
+            static_cast<void*>(this), nullptr);
+        gst_object_unref(pad);
+    }
+
+    if (!(m_flvmux = gst_element_factory_make("flvmux", "flvmux0"))) {
+        LOG_ERROR("Failed to create element flvmux named flvmux0");
+        return false;
+    }
+    gst_bin_add_many(GST_BIN(m_pipeline), m_flvmux, nullptr);
+
+    if (!(m_rtmpsink = gst_element_factory_make("rtmpsink", "rtmpsink"))) {
+        LOG_ERROR("Failed to create element rtmpsink named rtmpsink0");
+        return false;
+    }
+    g_object_set(G_OBJECT(m_rtmpsink), "location", m_config.rtmp_uri.c_str(), nullptr);
+    // passthrough bypasses queue00 and its delay line
+    if (!m_rtmpsrc) {
+        configure_sink_delay(m_rtmpsink, m_delayLine.Delay());
+    }
+    gst_bin_add_many(GST_BIN(m_pipeline), m_rtmpsink, nullptr);
+
+    if (m_rtmpsrc) {
+        if (!gst_element_link_many(m_rtmpsrc, m_h264parse, m_flvmux, m_rtmpsink, nullptr)) {
+            LOG_ERROR("Failed to link rtmpsrc0->h264parse->flvmux0->rtmpsink0");
+            return false;
+        }
+    } else if (!gst_element_link_many(m_queue11, m_nvvideoconvert0, m_capfilter1,
+        m_encoder, m_h264parse, m_flvmux, m_rtmpsink, nullptr)) {
+        LOG_ERROR("Failed to link queue11->{}0->capfilter1->{}0->h264parse->flvmux0->rtmpsink0",
+            m_backend->converter, m_backend->encoder);
+        return false;
+    }
+
+    // fed by the parser of uridecodebin instead of tee1 in passthrough
+    return LinkBranch(m_rtmpsrc ? nullptr : m_tee1, BranchElements(RTMP_BRANCH));
+}
+
+bool VideoPipeline::CreateInferenceBranch()
+{
+    GstCaps* cvt_caps;
+    GstPad* gst_pad;
+    GstAppSinkCallbacks appsink_callbacks = { };
+    std::string name;
+    std::vector<GstElement*> elements;
+    bool cpu_batching = m_streammuxer && m_config.batch_muxer == "cpubatchmux";
+    bool scaled = m_config.cvt_width > 0 && m_config.cvt_height > 0;
+
+    if (!(m_queue01 = gst_element_factory_make("queue", "queue01"))) {
+        LOG_ERROR("Failed to create element queue named queue01");
+        return false;
+    }
+    configure_queue(m_queue01, m_config.queue01, &m_queue01_dropped);
+    gst_bin_add_many(GST_BIN(m_pipeline), m_queue01, nullptr);
+
+    if (m_multiScaler.Size() && m_streammuxer) {
+        LOG_WARN("Pipeline[{}]: inference outputs need a single source, disabled", m_config.pipeline_id);
+    } else if (m_multiScaler.Size() &&
+        !MultiScaler::Supported(gst_video_format_from_string(m_config.cvt_format.c_str()))) {
+        LOG_WARN("Pipeline[{}]: inference outputs can't scale {} frames, disabled",
+            m_config.pipeline_id, m_config.cvt_format);
+    }
+
+    // the GPU takes the bulk of the scaling, the CPU only what is left per output
+    m_inferPrescale = m_multiScaler.Size() && !m_streammuxer && !scaled &&
+        m_backend->type == BACKEND_NVIDIA &&
+        MultiScaler::Supported(gst_video_format_from_string(m_config.cvt_format.c_str()));
+
+    if (cpu_batching && (!m_crop.empty() || scaled)) {
+        LOG_WARN("Pipeline[{}]: crop and scale of the inference branch are ignored with cpubatchmux",
+            m_config.pipeline_id);
+    }
+
+    // frames of cpubatchmux are already converted per source
+    if (!cpu_batching) {
+        // only nvvideoconvert crops by itself, kept even without a crop to set one later
+        if (m_backend->type != BACKEND_NVIDIA) {
+            if (!(m_videocrop = gst_element_factory_make("videocrop", "videocrop0"))) {
+                LOG_ERROR("Failed to create element videocrop named videocrop0");
+                return false;
+            }
+            gst_bin_add_many(GST_BIN(m_pipeline), m_videocrop, nullptr);
+        }
+
+        name = std::string(m_backend->converter) + "1";
+        if (!(m_nvvideoconvert1 = gst_element_factory_make(m_backend->converter, name.c_str()))) {
+            LOG_ERROR("Failed to create element {} named {}", m_backend->converter, name);
+            return false;
+        }
+
+        if (m_backend->type == BACKEND_NVIDIA) {
+            g_object_set(G_OBJECT(m_nvvideoconvert1), "nvbuf-memory-type", m_config.cvt_memory_type, nullptr);
+        }
+
+        gst_bin_add_many(GST_BIN(m_pipeline), m_nvvideoconvert1, nullptr);
+
+        // videoconvert keeps the size
+        if (scaled && m_backend->type == BACKEND_SOFTWARE) {
+            if (!(m_videoscale = gst_element_factory_make("videoscale", "videoscale1"))) {
+                LOG_ERROR("Failed to create element videoscale named videoscale1");
+                return false;
+            }
+            gst_bin_add_many(GST_BIN(m_pipeline), m_videoscale, nullptr);
+        }
+
+        if (!(m_capfilter2 = gst_element_factory_make("capsfilter", "capfilter2"))) {
+            LOG_ERROR("Failed to create element capsfilter named capfilter2");
+            return false;
+        }
+
+        cvt_caps = make_infer_caps(m_config.cvt_format, m_backend->memory,
+            scaled ? m_config.cvt_width : 0, scaled ? m_config.cvt_height : 0);
+        g_object_set(G_OBJECT(m_capfilter2), "caps", cvt_caps, nullptr);
+        gst_caps_unref(cvt_caps);
+
+        gst_bin_add_many(GST_BIN(m_pipeline), m_capfilter2, nullptr);
+    }
+
+    // gst_pad = gst_element_get_static_pad(m_nvvideoconvert1, "sink");
+    // m_cvt_sink_probe = gst_pad_add_probe(gst_pad, (GstPadProbeType)(
+    //                     GST_PAD_PROBE_TYPE_BUFFER), cb_sync_before_buffer_probe,
+    //                     static_cast<void*>(this), nullptr);
+    // gst_object_unref(gst_pad);
+
+    // gst_pad = gst_element_get_static_pad(m_nvvideoconvert1, "src");
+    // m_cvt_sink_probe = gst_pad_add_probe(gst_pad, (GstPadProbeType)(
+    //                     GST_PAD_PROBE_TYPE_BUFFER), cb_sync_after_buffer_probe,
+    //                     static_cast<void*>(this), nullptr);
+    // gst_object_unref(gst_pad);
+
+    if (!(m_appsink = gst_element_factory_make("appsink", "appsink"))) {
+        LOG_ERROR("Failed to create element appsink named appsink");
+        return false;
+    }
+
+    // bounded, the internal queue of appsink is unlimited by default
+    g_object_set(m_appsink, "emit-signals", false,
+        "max-buffers", m_config.appsink_max_buffers,
+        "drop", m_config.appsink_drop,
+        "wait-on-eos", m_config.appsink_wait_on_eos, nullptr);
+
+    appsink_callbacks.new_sample = cb_appsink_new_sample;
+    gst_app_sink_set_callbacks(GST_APP_SINK(m_appsink), &appsink_callbacks,
+        static_cast<void*>(this), nullptr);
+
+    gst_bin_add_many(GST_BIN(m_pipeline), m_appsink, nullptr);
+
+    elements = BranchElements(INFERENCE_BRANCH);
+    for (size_t i = 1; i < elements.size(); i++) {
+        if (!gst_element_link(elements[i - 1], elements[i])) {
+            LOG_ERROR("Failed to link {}->{}", GST_ELEMENT_NAME(elements[i - 1]),
+                GST_ELEMENT_NAME(elements[i]));
+            return false;
+        }
+    }
+
+    // the sink pad behind queue01, so dropped frames are neither cropped nor converted
+    if (m_rateController.Enabled()) {
+        gst_pad = gst_element_get_static_pad(elements[1], "sink");
+        m_cvt_sink_probe = gst_pad_add_probe(gst_pad, GST_PAD_PROBE_TYPE_BUFFER,
+            cb_inference_rate_probe, static_cast<void*>(this), nullptr);
+        gst_object_unref(gst_pad);
+    }
+
+    if (!cpu_batching) {
+        gst_pad = gst_element_get_static_pad(m_videocrop ? m_videocrop : m_nvvideoconvert1, "sink");
+        gst_pad_add_probe(gst_pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+            cb_crop_caps_probe, static_cast<void*>(this), nullptr);
+        gst_object_unref(gst_pad);
+    }
+
+    return LinkBranch(m_tee0, BranchElements(INFERENCE_BRANCH));
+}
 
-    if (!(m_pipeline = gst_pipeline_new("video-pipeline"))) {
-        LOG_ERROR("Failed to create pipeline named video-pipeline");
+bool VideoPipeline::Create()
+{
+    GstPad* gst_pad;
+    GstElement* input = nullptr;
+    bool cpu_batching;
+    bool standby = false;
+    guint tiler_columns;
+
+    m_startTime = g_get_monotonic_time();
+
+    const char* pipeline_name = m_config.pipeline_id.empty() ?
+        "video-pipeline" : m_config.pipeline_id.c_str();
+
+    if (!(m_pipeline = gst_pipeline_new(pipeline_name))) {
+        LOG_ERROR("Failed to create pipeline named {}", pipeline_name);
         goto exit;
     }
     gst_pipeline_set_auto_flush_bus(GST_PIPELINE(m_pipeline), true);
 
-    input = m_config.input_type == VideoType::USB_CAMERE ? CreateV4l2src() : CreateUridecodebin();
-    if (!input) {
+    LOG_INFO("Pipeline[{}]: backend: {}", m_config.pipeline_id, m_backend->name);
+
+    if (!m_config.batch_sources.empty()) {
+        if (m_backend->type != BACKEND_NVIDIA && m_config.batch_muxer != "cpubatchmux") {
+            LOG_WARN("{} is only available on nvidia, use cpubatchmux", m_config.batch_muxer);
+            m_config.batch_muxer = "cpubatchmux";
+        }
+        input = CreateStreammux();
+    } else if (m_config.input_type == VideoType::USB_CAMERE) {
+        input = CreateV4l2src();
+    } else if (m_config.src_uri.empty()) {
+        // warm standby, uridecodebin is added by BindSource()
+        LOG_INFO("Pipeline[{}]: created without source for standby", m_config.pipeline_id);
+        standby = true;
+    } else {
+        input = m_source = CreateUridecodebin(m_config.src_uri, 0);
+    }
+
+    if (!input && !standby) {
         LOG_ERROR("Can't process input source.");
         goto exit;
     }
@@ -384,17 +1732,34 @@ bool VideoPipeline::Create()
     }
     gst_bin_add_many(GST_BIN(m_pipeline), m_tee0, nullptr);
 
-    if (m_config.input_type == VideoType::USB_CAMERE) {
+    // frames of a muxer or a decoder out of reach are stamped here
+    if (m_config.enable_latency_trace) {
+        add_latency_probe(m_tee0, "sink", cb_latency_stamp_probe, this);
+    }
+
+    gst_pad = gst_element_get_static_pad(m_tee0, "sink");
+    gst_pad_add_probe(gst_pad, GST_PAD_PROBE_TYPE_BUFFER, cb_first_frame_probe,
+        static_cast<void*>(this), nullptr);
+    gst_object_unref(gst_pad);
+
+    if (m_streammuxer || m_config.input_type == VideoType::USB_CAMERE) {
         if (!gst_element_link_many(input, m_tee0, nullptr)) {
-            LOG_ERROR("Failed to link jpegdec0->tee0");
+            LOG_ERROR("Failed to link {}->tee0", GST_ELEMENT_NAME(input));
             goto exit;
         }
     }
 
+    // batches of cpubatchmux can only be inferred
+    cpu_batching = m_streammuxer && m_config.batch_muxer == "cpubatchmux";
+    if (cpu_batching && (m_config.enable_hdmi || m_config.enable_rtmp)) {
+        LOG_WARN("Display and rtmp are not supported by cpubatchmux, disabled");
+    }
+
     if (!(m_queue00 = gst_element_factory_make("queue", "queue00"))) {
         LOG_ERROR("Failed to create element queue named queue00");
         goto exit;
     }
+    configure_queue(m_queue00, m_config.queue00, &m_queue00_dropped);
 
     // add probe to queue0
     gst_pad = gst_element_get_static_pad(m_queue00, "src");
@@ -403,6 +1768,19 @@ bool VideoPipeline::Create()
                         static_cast<void*>(this), nullptr);
     gst_object_unref(gst_pad);
 
+    if (m_delayLine.Enabled()) {
+        gst_pad = gst_element_get_static_pad(m_queue00, "sink");
+        gst_pad_add_probe(gst_pad, GST_PAD_PROBE_TYPE_BUFFER, cb_delay_push_probe,
+            static_cast<void*>(this), nullptr);
+        gst_object_unref(gst_pad);
+
+        // queue00 stores the delayed frames
+        if (m_config.queue00.max_time && m_config.queue00.max_time < (guint64)m_delayLine.Delay()) {
+            LOG_WARN("Pipeline[{}]: queue00 holds less than the osd delay of {}ms",
+                m_config.pipeline_id, m_config.osd_max_delay);
+        }
+    }
+
     gst_bin_add_many(GST_BIN(m_pipeline), m_queue00, nullptr);
 
     if (!gst_element_link_many(m_tee0, m_queue00, nullptr)) {
@@ -410,12 +1788,13 @@ bool VideoPipeline::Create()
         goto exit;
     }
 
-    if (!m_config.enable_hdmi && !m_config.enable_rtmp) {
+    if (cpu_batching) {
         if (!(m_fakesink = gst_element_factory_make("fakesink", "fakesink0"))) {
             LOG_ERROR("Failed to create element fakesink named fakesink0");
             goto exit;
         }
         g_object_set(G_OBJECT(m_fakesink), "sync", true, nullptr);
+        configure_sink_delay(m_fakesink, m_delayLine.Delay());
 
         gst_bin_add_many(GST_BIN(m_pipeline), m_fakesink, nullptr);
 
@@ -428,167 +1807,256 @@ bool VideoPipeline::Create()
         LOG_ERROR("Failed to create element tee0 named tee1");
         goto exit;
         }
+        // display and rtmp come and go at runtime, keep pushing with none of them
+        g_object_set(G_OBJECT(m_tee1), "allow-not-linked", true, nullptr);
         gst_bin_add_many(GST_BIN(m_pipeline), m_tee1, nullptr);
 
-        if (!gst_element_link_many(m_queue00, m_tee1, nullptr)) {
-            LOG_ERROR("Failed to link queue00->tee1");
-            goto exit;
-        }
-
-        if (m_config.enable_hdmi) {
-            if (!(m_queue10 = gst_element_factory_make("queue", "queue10"))) {
-                LOG_ERROR("Failed to create element queue named queue10");
+        if (m_streammuxer) {
+            // composite the batch into one frame for display and rtmp
+            if (!(m_tiler = gst_element_factory_make("nvmultistreamtiler", "nvmultistreamtiler0"))) {
+                LOG_ERROR("Failed to create element nvmultistreamtiler named nvmultistreamtiler0");
                 goto exit;
             }
-            gst_bin_add_many(GST_BIN(m_pipeline), m_queue10, nullptr);
 
-            if (!(m_nveglglessink = gst_element_factory_make("nveglglessink", "nveglglessink0"))) {
-                LOG_ERROR("Failed to create element nveglglessink named nveglglessink0");
-                goto exit;
-            }
-            g_object_set(G_OBJECT(m_nveglglessink),
-                "sync", m_config.hdmi_sync,
-                "window-x", m_config.window_x,
-                "window-y", m_config.window_y,
-                "window-width", m_config.window_width,
-                "window-height", m_config.window_height, nullptr);
+            tiler_columns = (guint)std::ceil(std::sqrt((double)m_config.batch_sources.size()));
+            g_object_set(G_OBJECT(m_tiler),
+                "columns", tiler_columns,
+                "rows", (guint)((m_config.batch_sources.size() + tiler_columns - 1) / tiler_columns),
+                "width", m_config.batch_width,
+                "height", m_config.batch_height, nullptr);
 
-            gst_bin_add_many(GST_BIN(m_pipeline), m_nveglglessink, nullptr);
+            gst_bin_add_many(GST_BIN(m_pipeline), m_tiler, nullptr);
 
-            if (!gst_element_link_many(m_tee1, m_queue10, m_nveglglessink, nullptr)) {
-                LOG_ERROR("Failed to link tee1->queue10->nveglglessink0");
+            if (!gst_element_link_many(m_queue00, m_tiler, m_tee1, nullptr)) {
+                LOG_ERROR("Failed to link queue00->nvmultistreamtiler0->tee1");
                 goto exit;
             }
+        } else if (!gst_element_link_many(m_queue00, m_tee1, nullptr)) {
+            LOG_ERROR("Failed to link queue00->tee1");
+            goto exit;
         }
 
-        if (m_config.enable_rtmp) {
-            if (!(m_queue11 = gst_element_factory_make("queue", "queue11"))) {
-                LOG_ERROR("Failed to create element queue named queue11");
+        if (!m_config.enable_hdmi && !m_config.enable_rtmp) {
+            if (!(m_fakesink = gst_element_factory_make("fakesink", "fakesink0"))) {
+                LOG_ERROR("Failed to create element fakesink named fakesink0");
                 goto exit;
             }
-            gst_bin_add_many(GST_BIN(m_pipeline), m_queue11, nullptr);
+            g_object_set(G_OBJECT(m_fakesink), "sync", true, nullptr);
+            configure_sink_delay(m_fakesink, m_delayLine.Delay());
+
+            gst_bin_add_many(GST_BIN(m_pipeline), m_fakesink, nullptr);
 
-            if (!(m_nvvideoconvert0 = gst_element_factory_make("nvvideoconvert", "nvvideoconvert0"))) {
-                LOG_ERROR("Failed to create element nvvideoconvert named nvvideoconvert0");
+            if (!gst_element_link_many(m_tee1, m_fakesink, nullptr)) {
+                LOG_ERROR("Failed to link tee1->fakesink0");
                 goto exit;
             }
-            g_object_set(G_OBJECT(m_nvvideoconvert0), "nvbuf-memory-type", m_config.cvt_memory_type, nullptr);
-            gst_bin_add_many(GST_BIN(m_pipeline), m_nvvideoconvert0, nullptr);
+        }
 
-            cvt_caps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, "NV12", nullptr);
-            feature = gst_caps_features_new("memory:NVMM", nullptr);
-            gst_caps_set_features(cvt_caps, 0, feature);
+        if (m_config.enable_hdmi && !CreateDisplayBranch()) {
+            goto exit;
+        }
 
-            if (!(m_capfilter1 = gst_element_factory_make("capsfilter", "capfilter1"))) {
-                LOG_ERROR("Failed to create element capsfilter named capfilter1");
-                goto exit;
+        // kept across detach and attach of the rtmp branch
+        if (m_config.enable_record) {
+            m_recorder.reset(new EventRecorder((GstClockTime)m_config.record_pre_event * GST_SECOND,
+                (GstClockTime)m_config.record_post_event * GST_SECOND,
+                (size_t)m_config.record_max_bytes, m_context));
+            if (!m_config.enable_rtmp) {
+                LOG_WARN("Pipeline[{}]: recording taps the rtmp branch, nothing is recorded until it's attached",
+                    m_config.pipeline_id);
             }
+        }
 
-            g_object_set(G_OBJECT(m_capfilter1), "caps", cvt_caps, nullptr);
-            gst_caps_unref(cvt_caps);
+        if (m_config.enable_rtmp && !CreateRtmpBranch()) {
+            goto exit;
+        }
+    }
 
-            gst_bin_add_many(GST_BIN(m_pipeline), m_capfilter1, nullptr);
+    if (m_config.enable_appsink && !CreateInferenceBranch()) {
+        goto exit;
+    }
 
-            if (!(m_encoder = gst_element_factory_make("nvv4l2h264enc", "nvv4l2h264enc0"))) {
-                LOG_ERROR("Failed to create element nvv4l2h264enc named nvv4l2h264enc0");
-                goto exit;
-            }
-            g_object_set(G_OBJECT(m_encoder), "bitrate", m_config.enc_bitrate,
-                "iframeinterval", m_config.enc_iframe_interval, nullptr);
-            gst_bin_add_many(GST_BIN(m_pipeline), m_encoder, nullptr);
+    if (ReconnectEnabled()) {
+        EnableReconnect();
+    }
 
-            if (!(m_h264parse = gst_element_factory_make("h264parse", "h264parse0"))) {
-                LOG_ERROR("Failed to create element h264parse named h264parse0");
-                goto exit;
-            }
-            gst_bin_add_many(GST_BIN(m_pipeline), m_h264parse, nullptr);
+    if (m_config.enable_latency_trace && m_config.latency_dump_interval > 0) {
+        m_latencyDumpSource = g_timeout_source_new_seconds(m_config.latency_dump_interval);
+        g_source_set_callback(m_latencyDumpSource, cb_dump_latency, this, nullptr);
+        g_source_attach(m_latencyDumpSource, m_context);
+    }
 
-            if (!(m_flvmux = gst_element_factory_make("flvmux", "flvmux0"))) {
-                LOG_ERROR("Failed to create element flvmux named flvmux0");
-                goto exit;
-            }
-            gst_bin_add_many(GST_BIN(m_pipeline), m_flvmux, nullptr);
+    return true;
 
-            if (!(m_rtmpsink = gst_element_factory_make("rtmpsink", "rtmpsink"))) {
-                LOG_ERROR("Failed to create element rtmpsink named rtmpsink0");
-                goto exit;
-            }
-            g_object_set(G_OBJECT(m_rtmpsink), "location", m_config.rtmp_uri.c_str(), nullptr);
-            gst_bin_add_many(GST_BIN(m_pipeline), m_rtmpsink, nullptr);
+exit:
+    LOG_ERROR("Failed to create video pipeline");
+    return false;
+}
 
-            if (!gst_element_link_many(m_tee1, m_queue11, m_nvvideoconvert0,
-                m_capfilter1, m_encoder, m_h264parse, m_flvmux, m_rtmpsink, nullptr)) {
-                LOG_ERROR("Failed to link tee1->queue11->nvvideoconvert0->capfilter1->nvv4l2h264enc0->h264parse->flvmux0->rtmpsink0");
-                goto exit;
-            }
-        }
+// only uridecodebin is rebuilt on a stall or an error, tee0 and the branches keep running
+void VideoPipeline::EnableReconnect()
+{
+    GstBus* bus;
+    GstPad* gst_pad;
+
+    bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
+    gst_bus_set_sync_handler(bus, cb_source_bus_sync, this, nullptr);
+    gst_object_unref(bus);
+
+    gst_pad = gst_element_get_static_pad(m_tee0, "sink");
+    gst_pad_add_probe(gst_pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER |
+        GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM), cb_source_alive_probe,
+        static_cast<void*>(this), nullptr);
+    gst_object_unref(gst_pad);
+
+    m_lastBufferTime = g_get_monotonic_time();
+    m_watchdogSource = g_timeout_source_new(MAX(m_config.reconnect_timeout / 2, 100));
+    g_source_set_callback(m_watchdogSource, cb_source_watchdog, this, nullptr);
+    g_source_attach(m_watchdogSource, m_context);
+}
+
+/**
+ * @brief Bring a pipeline created without source to READY, so elements,
+ * plugins and devices are ready before a stream is bound to it.
+ * @Author: Ricardo Lu
+ */
+bool VideoPipeline::Warm()
+{
+    if (GST_STATE_CHANGE_FAILURE == gst_element_set_state(m_pipeline,
+        GST_STATE_READY)) {
+        LOG_ERROR("Pipeline[{}]: failed to set pipeline to ready state", m_config.pipeline_id);
+        return false;
     }
 
-    if (m_config.enable_appsink) {
-        if (!(m_queue01 = gst_element_factory_make("queue", "queue01"))) {
-            LOG_ERROR("Failed to create element queue named queue01");
-            goto exit;
-        }
-        gst_bin_add_many(GST_BIN(m_pipeline), m_queue01, nullptr);
+    return true;
+}
 
-        if (!(m_nvvideoconvert1 = gst_element_factory_make("nvvideoconvert", "nvvideoconvert1"))) {
-            LOG_ERROR("Failed to create element nvvideoconvert named nvvideoconvert1");
-            goto exit;
-        }
+/**
+ * @brief Bind a stream to a warm standby pipeline and start it, only
+ * uridecodebin is created, the rest of the pipeline is reused as is.
+ * @Author: Ricardo Lu
+ * @param[in] id - new name of the pipeline.
+ * @param[in] uri - source of uridecodebin.
+ */
+bool VideoPipeline::BindSource(const std::string& id, const std::string& uri)
+{
+    if (!m_pipeline || m_source || m_streammuxer ||
+        m_config.input_type == VideoType::USB_CAMERE) {
+        LOG_ERROR("Pipeline[{}]: not a standby pipeline, can't bind {}", m_config.pipeline_id, uri);
+        return false;
+    }
 
-        g_object_set(G_OBJECT(m_nvvideoconvert1), "nvbuf-memory-type", m_config.cvt_memory_type, nullptr);
+    m_startTime = g_get_monotonic_time();
+    m_warmStart = true;
 
-        gst_bin_add_many(GST_BIN(m_pipeline), m_nvvideoconvert1, nullptr);
+    LOG_INFO("Pipeline[{}]: bind {} as {}", m_config.pipeline_id, uri, id);
+    m_config.pipeline_id = id;
+    m_config.src_uri = uri;
+    gst_object_set_name(GST_OBJECT(m_pipeline), id.c_str());
 
-        cvt_caps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, m_config.cvt_format.c_str(), nullptr);
-        feature = gst_caps_features_new("memory:NVMM", nullptr);
-        gst_caps_set_features(cvt_caps, 0, feature);
+    // the passthrough appsrc was created without uri, live for rtsp as in Create()
+    if (m_rtmpsrc) {
+        g_object_set(G_OBJECT(m_rtmpsrc), "is-live",
+            g_str_has_prefix(uri.c_str(), "rtsp://"), nullptr);
+    }
 
-        if (!(m_capfilter2 = gst_element_factory_make("capsfilter", "capfilter2"))) {
-            LOG_ERROR("Failed to create element capsfilter named capfilter2");
-            goto exit;
+    if (!(m_source = CreateUridecodebin(uri, 0))) {
+        return false;
+    }
+
+    if (ReconnectEnabled()) {
+        EnableReconnect();
+    }
+
+    return Start();
+}
+
+/**
+ * @brief Called by the consumer once the result of a frame can be fetched by
+ * GetPtsResultFunc or GetBatchResultFunc, releases it from the delay line.
+ * @Author: Ricardo Lu
+ * @param[in] pts - PTS of the inferred frame.
+ */
+void VideoPipeline::OnResult(uint64_t pts)
+{
+    // the sinks are updated in the main context, not in the thread of the consumer
+    if (m_delayLine.Enabled() && m_delayLine.Notify(pts, LatencyTracer::Now())) {
+        g_mutex_lock(&m_mutex);
+        if (!m_osdDelaySource && !m_isExited) {
+            m_osdDelaySource = g_idle_source_new();
+            g_source_set_callback(m_osdDelaySource, cb_osd_delay, this, nullptr);
+            g_source_attach(m_osdDelaySource, m_context);
         }
+        g_mutex_unlock(&m_mutex);
+    }
 
-        g_object_set(G_OBJECT(m_capfilter2), "caps", cvt_caps, nullptr);
-        gst_caps_unref(cvt_caps);
-
-        gst_bin_add_many(GST_BIN(m_pipeline), m_capfilter2, nullptr);
+    OnInferenceDone();
+}
 
-        // gst_pad = gst_element_get_static_pad(m_nvvideoconvert1, "sink");
-        // m_cvt_sink_probe = gst_pad_add_probe(gst_pad, (GstPadProbeType)(
-        //                     GST_PAD_PROBE_TYPE_BUFFER), cb_sync_before_buffer_probe,
-        //                     static_cast<void*>(this), nullptr);
-        // gst_object_unref(gst_pad);
+/**
+ * @brief Render the frames behind queue00 late by the measured delay of the
+ * delay line instead of its cap. The inference branch and the rtmp
+ * passthrough don't wait for results and keep their timing. m_mutex held.
+ * @Author: Ricardo Lu
+ */
+void VideoPipeline::ApplyOsdDelay()
+{
+    int64_t delay = m_delayLine.Delay();
 
-        // gst_pad = gst_element_get_static_pad(m_nvvideoconvert1, "src");
-        // m_cvt_sink_probe = gst_pad_add_probe(gst_pad, (GstPadProbeType)(
-        //                     GST_PAD_PROBE_TYPE_BUFFER), cb_sync_after_buffer_probe,
-        //                     static_cast<void*>(this), nullptr);
-        // gst_object_unref(gst_pad);
+    configure_sink_delay(m_nveglglessink, delay);
+    if (!m_rtmpsrc) {
+        configure_sink_delay(m_rtmpsink, delay);
+    }
+    configure_sink_delay(m_fakesink, delay);
 
-        if (!(m_appsink = gst_element_factory_make("appsink", "appsink"))) {
-            LOG_ERROR("Failed to create element appsink named appsink");
-            goto exit;
-        }
+    LOG_DEBUG("Pipeline[{}]: osd delay {}ms", m_config.pipeline_id, delay / GST_MSECOND);
+}
 
-        g_object_set(m_appsink, "emit-signals", true, nullptr);
+/**
+ * @brief Called by the consumer each time it finished a frame, the consumer
+ * rate adaptive_infer follows. OnResult() calls it already.
+ * @Author: Ricardo Lu
+ */
+void VideoPipeline::OnInferenceDone()
+{
+    if (m_rateController.Enabled()) {
+        m_rateController.OnConsumed();
+    }
+}
 
-        g_signal_connect(m_appsink, "new-sample",
-            G_CALLBACK(cb_appsink_new_sample), static_cast<void*>(this));
+/**
+ * @brief Write the pre-event and what follows to an MP4 file, until
+ * record_post_event after the last trigger or StopRecord(). Triggers during
+ * a recording extend it.
+ * @Author: Ricardo Lu
+ * @param[in] path - of the MP4 file, ignored when extending.
+ */
+bool VideoPipeline::TriggerRecord(const std::string& path)
+{
+    if (!m_recorder) {
+        LOG_WARN("Pipeline[{}]: recording isn't enabled", m_config.pipeline_id);
+        return false;
+    }
 
-        gst_bin_add_many(GST_BIN(m_pipeline), m_appsink, nullptr);
+    return m_recorder->Trigger(path);
+}
 
-        if (!gst_element_link_many(m_tee0, m_queue01, m_nvvideoconvert1, m_capfilter2, m_appsink, nullptr)) {
-            LOG_ERROR("Failed to link tee0->queue01->nvvideoconvert1->capfilter1->appsink");
-            goto exit;
-        }
+void VideoPipeline::StopRecord()
+{
+    if (m_recorder) {
+        m_recorder->Stop();
     }
+}
 
-    return true;
-
-exit:
-    LOG_ERROR("Failed to create video pipeline");
-    return false;
+/**
+ * @brief Time from Create(), or BindSource() for a standby pipeline, to
+ * the first buffer into tee0.
+ * @Author: Ricardo Lu
+ * @return us, -1 until the first buffer.
+ */
+int64_t VideoPipeline::GetTimeToFirstFrame()
+{
+    return m_timeToFirstFrame;
 }
 
 bool VideoPipeline::Start(void)
@@ -658,40 +2126,89 @@ bool VideoPipeline::Resume(void)
 
 void VideoPipeline::Destroy(void)
 {
-    GstPad* teeSrcPad;
-    while(teeSrcPad = gst_element_get_request_pad(m_tee0, "src_%u")) {
-        gst_element_release_request_pad(m_tee0, teeSrcPad);
-        g_object_unref(teeSrcPad);
+    if (!m_pipeline) {
+        return;
     }
 
-    while(teeSrcPad = gst_element_get_request_pad(m_tee1, "src_%u")) {
-        gst_element_release_request_pad(m_tee1, teeSrcPad);
-        g_object_unref(teeSrcPad);
+    LOG_INFO("Pipeline[{}]: GstSampleObject pool hit: {}, miss: {}",
+        m_config.pipeline_id, m_samplePool.hits(), m_samplePool.misses());
+    if (m_watchdogSource) {
+        g_source_destroy(m_watchdogSource);
+        g_source_unref(m_watchdogSource);
+        m_watchdogSource = nullptr;
+    }
+    // no more rebuild scheduled from now on
+    g_mutex_lock(&m_mutex);
+    m_isExited = true;
+    if (m_reconnectSource) {
+        g_source_destroy(m_reconnectSource);
+        g_source_unref(m_reconnectSource);
+        m_reconnectSource = nullptr;
+    }
+    if (m_segmentSeekSource) {
+        g_source_destroy(m_segmentSeekSource);
+        g_source_unref(m_segmentSeekSource);
+        m_segmentSeekSource = nullptr;
+    }
+    if (m_osdDelaySource) {
+        g_source_destroy(m_osdDelaySource);
+        g_source_unref(m_osdDelaySource);
+        m_osdDelaySource = nullptr;
+    }
+    g_mutex_unlock(&m_mutex);
+    if (m_latencyDumpSource) {
+        g_source_destroy(m_latencyDumpSource);
+        g_source_unref(m_latencyDumpSource);
+        m_latencyDumpSource = nullptr;
+    }
+    if (m_config.enable_latency_trace) {
+        DumpLatency();
+    }
+
+    LOG_INFO("Pipeline[{}]: dropped by queue00: {}, queue01: {}, queue10: {}, queue11: {}",
+        m_config.pipeline_id, m_queue00_dropped.load(), m_queue01_dropped.load(),
+        m_queue10_dropped.load(), m_queue11_dropped.load());
+    if (m_rateController.Enabled()) {
+        LOG_INFO("Pipeline[{}]: inference admitted: {}, skipped: {}, consumer fps: {:.1f}",
+            m_config.pipeline_id, m_rateController.Admitted(), m_rateController.Dropped(),
+            m_rateController.ConsumerFps());
+    }
+
+    if (m_delayLine.Enabled()) {
+        LOG_INFO("Pipeline[{}]: osd delay: {}ms, released on result: {}, on deadline: {}",
+            m_config.pipeline_id, m_delayLine.Delay() / GST_MSECOND,
+            m_delayLine.ReleasedOnResult(), m_delayLine.ReleasedOnDeadline());
     }
 
-    if (m_pipeline) {
-        m_isExited = true;
-        g_mutex_lock(&m_syncMuxtex);
-        g_atomic_int_inc(&m_syncCount);
-        g_cond_signal(&m_syncCondition);
-        g_mutex_unlock(&m_syncMuxtex);
+    m_isExited = true;
+    m_delayLine.Flush();
+    g_mutex_lock(&m_syncMuxtex);
+    g_atomic_int_inc(&m_syncCount);
+    g_cond_signal(&m_syncCondition);
+    g_mutex_unlock(&m_syncMuxtex);
 
-        gst_element_set_state(m_pipeline, GST_STATE_NULL);
+    gst_element_set_state(m_pipeline, GST_STATE_NULL);
 
-        gst_object_unref(m_pipeline);
+    // nothing is pushed anymore, the last clip is finalized here
+    m_recorder.reset();
 
-        m_pipeline = nullptr;
+    if (ReconnectEnabled()) {
+        GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
+        gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
+        gst_object_unref(bus);
     }
 
-    // if (m_cvt_sink_probe != -1 && m_nvvideoconvert1) {
-    //     GstPad *gstpad = gst_element_get_static_pad(m_nvvideoconvert1, "sink");
-    //     if (!gstpad) {
-    //         LOG_ERROR("Could not find '{}' in '{}'", "sink", GST_ELEMENT_NAME(m_nvvideoconvert1));
-    //     }
-    //     gst_pad_remove_probe(gstpad, m_cvt_sink_probe);
-    //     gst_object_unref(gstpad);
-    //     m_cvt_sink_probe = -1;
-    // }
+    if (m_cvt_sink_probe != -1) {
+        GstElement* element = m_videocrop ? m_videocrop :
+            m_nvvideoconvert1 ? m_nvvideoconvert1 : m_appsink;
+        GstPad *gstpad = gst_element_get_static_pad(element, "sink");
+        if (!gstpad) {
+            LOG_ERROR("Could not find '{}' in '{}'", "sink", GST_ELEMENT_NAME(element));
+        }
+        gst_pad_remove_probe(gstpad, m_cvt_sink_probe);
+        gst_object_unref(gstpad);
+        m_cvt_sink_probe = -1;
+    }
 
     // if (m_cvt_src_probe != -1 && m_nvvideoconvert1) {
     //     GstPad *gstpad = gst_element_get_static_pad(m_nvvideoconvert1, "src");
@@ -723,9 +2240,112 @@ void VideoPipeline::Destroy(void)
         m_queue00_src_probe = -1;
     }
 
-    g_mutex_clear(&m_mutex);
-    g_mutex_clear(&m_syncMuxtex);
-    g_cond_clear(&m_syncCondition);
+    // tee hands out a new pad on every request, only release the linked ones
+    release_request_pads(m_tee0);
+    release_request_pads(m_tee1);
+
+    if (m_decoder) {
+        gst_object_unref(m_decoder);
+        m_decoder = nullptr;
+    }
+
+    // elements are owned by the pipeline
+    gst_object_unref(m_pipeline);
+    m_pipeline = nullptr;
+}
+
+/**
+ * @brief Change the region of the frames sent to inference, takes effect
+ * from the next frame.
+ * @Author: Ricardo Lu
+ * @param[in] crop - left:top:width:height in source pixels, empty for the whole frame.
+ * @return false if the crop can't be parsed.
+ */
+bool VideoPipeline::SetCrop(const std::string& crop)
+{
+    cv::Rect rect;
+
+    if (!parse_crop(crop, rect)) {
+        LOG_WARN("Pipeline[{}]: invalid crop {}", m_config.pipeline_id, crop);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_cropMutex);
+    m_crop = rect;
+    m_config.crop = crop;
+    ApplyCrop();
+
+    return true;
+}
+
+/**
+ * @brief Region of the source frame the inference frames are taken from,
+ * to map results back onto the source.
+ * @Author: Ricardo Lu
+ * @return empty until the crop is applied or without crop.
+ */
+cv::Rect VideoPipeline::GetCrop()
+{
+    std::lock_guard<std::mutex> lock(m_cropMutex);
+
+    return m_cropApplied;
+}
+
+// m_cropMutex held, waits for the caps to know the frame size
+void VideoPipeline::ApplyCrop()
+{
+    cv::Rect rect;
+    std::string src_crop;
+
+    if (!m_cropFrameWidth || !m_cropFrameHeight || (!m_videocrop && !m_nvvideoconvert1)) {
+        return;
+    }
+
+    rect = m_crop & cv::Rect(0, 0, m_cropFrameWidth, m_cropFrameHeight);
+    if (!m_crop.empty() && rect.empty()) {
+        LOG_WARN("Pipeline[{}]: crop {} is outside of the {}x{} frame, the whole frame is inferred",
+            m_config.pipeline_id, m_config.crop, m_cropFrameWidth, m_cropFrameHeight);
+    }
+
+    if (m_videocrop) {
+        g_object_set(G_OBJECT(m_videocrop), "left", rect.x, "top", rect.y,
+            "right", rect.empty() ? 0 : m_cropFrameWidth - rect.x - rect.width,
+            "bottom", rect.empty() ? 0 : m_cropFrameHeight - rect.y - rect.height, nullptr);
+    } else {
+        src_crop = std::to_string(rect.x) + ":" + std::to_string(rect.y) + ":" +
+            std::to_string(rect.width) + ":" + std::to_string(rect.height);
+        g_object_set(G_OBJECT(m_nvvideoconvert1), "src-crop", src_crop.c_str(), nullptr);
+    }
+
+    if (rect != m_cropApplied) {
+        LOG_INFO("Pipeline[{}]: inference crop: {}:{}:{}:{}", m_config.pipeline_id,
+            rect.x, rect.y, rect.width, rect.height);
+    }
+    m_cropApplied = rect;
+
+    if (m_inferPrescale && m_capfilter2) {
+        ApplyPrescale(rect.empty() ? cv::Size(m_cropFrameWidth, m_cropFrameHeight) : rect.size());
+    }
+}
+
+// m_cropMutex held, renegotiates nvvideoconvert1 when the size changes
+void VideoPipeline::ApplyPrescale(const cv::Size& ref)
+{
+    cv::Size size = infer_prescale_size(ref, m_multiScaler);
+    GstCaps* caps;
+
+    m_inferRef = ref;
+    if (size == m_inferSize) {
+        return;
+    }
+
+    caps = make_infer_caps(m_config.cvt_format, m_backend->memory, size.width, size.height);
+    g_object_set(G_OBJECT(m_capfilter2), "caps", caps, nullptr);
+    gst_caps_unref(caps);
+    m_inferSize = size;
+
+    LOG_INFO("Pipeline[{}]: {}1 scales {}x{} to {}x{} for the inference outputs",
+        m_config.pipeline_id, m_backend->converter, ref.width, ref.height, size.width, size.height);
 }
 
 void VideoPipeline::SetCallbacks(PutFrameFunc func, void* args)
@@ -744,9 +2364,436 @@ void VideoPipeline::SetCallbacks(GetResultFunc func, void* args)
     m_getResultArgs = args;
 }
 
+void VideoPipeline::SetCallbacks(GetPtsResultFunc func, void* args)
+{
+    LOG_INFO("set GetPtsResultFunc callback called");
+
+    m_getPtsResultFunc = func;
+    m_getPtsResultArgs = args;
+}
+
+void VideoPipeline::SetCallbacks(GetBatchResultFunc func, void* args)
+{
+    LOG_INFO("set GetBatchResultFunc callback called");
+
+    m_getBatchResultFunc = func;
+    m_getBatchResultArgs = args;
+}
+
 void VideoPipeline::SetCallbacks(ProcResultFunc func)
 {
     LOG_INFO("set ProcResultFunc callback called");
 
     m_procResultFunc = func;
 }
+
+void VideoPipeline::SetCallbacks(ProcBatchResultFunc func)
+{
+    LOG_INFO("set ProcBatchResultFunc callback called");
+
+    m_procBatchResultFunc = func;
+}
+
+bool VideoPipeline::SetCallbacks(const std::string& output, PutScaledFrameFunc func, void* args)
+{
+    for (size_t i = 0; i < m_multiScaler.Size(); i++) {
+        if (m_multiScaler.Config(i).name == output) {
+            LOG_INFO("set PutScaledFrameFunc callback of {} called", output);
+            m_scaledFrameFuncs[i] = std::make_pair(func, args);
+            return true;
+        }
+    }
+
+    LOG_WARN("Pipeline[{}]: no inference output named {}", m_config.pipeline_id, output);
+    return false;
+}
+
+/**
+ * @brief Scale the frame of appsink into every inference output and hand each
+ * one to its callback, the frame is mapped once and its pixels read once.
+ * @Author: Ricardo Lu
+ * @param[in] sample - pulled from appsink, still owned by the caller.
+ */
+bool VideoPipeline::ScaleOutputs(GstSample* sample)
+{
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    std::shared_ptr<const GstVideoInfo> info;
+    std::shared_ptr<cv::Mat> mapped;
+    GstCapsFeatures* features;
+    GstVideoFormat format;
+    cv::Mat frame;
+    bool ret = false;
+#ifdef ENABLE_DEEPSTREAM
+    NvBufSurface* surface = nullptr;
+    GstMapInfo map_info = GST_MAP_INFO_INIT;
+#endif
+
+    // a batch holds frames of several sources, warned in CreateInferenceBranch
+    if (m_streammuxer || !buffer ||
+        !(info = m_videoInfoCache.Lookup(gst_sample_get_caps(sample)))) {
+        return false;
+    }
+
+    format = GST_VIDEO_INFO_FORMAT(info.get());
+    if (!MultiScaler::Supported(format)) {
+        return false;
+    }
+
+    features = gst_caps_get_features(gst_sample_get_caps(sample), 0);
+    if (features && gst_caps_features_contains(features, "memory:NVMM")) {
+#ifndef ENABLE_DEEPSTREAM
+        // the buffer holds a NvBufSurface rather than pixels
+        return false;
+#else
+        if (!gst_buffer_map(buffer, &map_info, GST_MAP_READ)) {
+            return false;
+        }
+
+        surface = (NvBufSurface*)map_info.data;
+        NvBufSurfaceParams& params = surface->surfaceList[0];
+        // unified memory is readable by the CPU as is, others are mapped for this frame
+        if (surface->memType == NVBUF_MEM_CUDA_UNIFIED) {
+            frame = cv::Mat(params.height, params.width, CV_8UC(GST_VIDEO_INFO_COMP_PSTRIDE(info.get(), 0)),
+                params.dataPtr, params.pitch);
+        } else if (NvBufSurfaceMap(surface, 0, 0, NVBUF_MAP_READ) == 0) {
+            NvBufSurfaceSyncForCpu(surface, 0, 0);
+            frame = cv::Mat(params.height, params.width, CV_8UC(GST_VIDEO_INFO_COMP_PSTRIDE(info.get(), 0)),
+                params.mappedAddr.addr[0], params.pitch);
+        } else {
+            gst_buffer_unmap(buffer, &map_info);
+            return false;
+        }
+#endif
+    }
+
+    if (frame.empty()) {
+        if (!(mapped = MappedVideoFrame::Map(sample))) {
+            return false;
+        }
+        frame = *mapped;
+    }
+
+    if ((ret = m_multiScaler.Process(frame, format, m_scaledFrames))) {
+        // scales of the frame before nvvideoconvert1 scaled it down
+        if (m_inferPrescale) {
+            std::lock_guard<std::mutex> lock(m_cropMutex);
+            if (m_inferRef.width > 0 && m_inferRef.height > 0) {
+                for (ScaledFrame& scaled : m_scaledFrames) {
+                    scaled.scale_x *= (double)frame.cols / m_inferRef.width;
+                    scaled.scale_y *= (double)frame.rows / m_inferRef.height;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < m_scaledFrames.size(); i++) {
+            if (m_scaledFrameFuncs[i].first) {
+                m_scaledFrameFuncs[i].first(m_scaledFrames[i], GST_BUFFER_PTS(buffer),
+                    m_scaledFrameFuncs[i].second);
+            }
+        }
+    }
+
+#ifdef ENABLE_DEEPSTREAM
+    if (surface) {
+        if (surface->memType != NVBUF_MEM_CUDA_UNIFIED) {
+            NvBufSurfaceUnMap(surface, 0, 0);
+        }
+        gst_buffer_unmap(buffer, &map_info);
+    }
+#endif
+
+    return ret;
+}
+
+bool VideoPipeline::GetBatchFrames(GstBuffer* buffer, std::vector<BatchFrameInfo>& frames)
+{
+#ifdef ENABLE_DEEPSTREAM
+    NvDsBatchMeta* nvds_batch_meta;
+#endif
+    GstBatchMeta* batch_meta;
+
+    frames.clear();
+
+#ifdef ENABLE_DEEPSTREAM
+    if ((nvds_batch_meta = gst_buffer_get_nvds_batch_meta(buffer))) {
+        for (NvDsMetaList* l = nvds_batch_meta->frame_meta_list; l; l = l->next) {
+            NvDsFrameMeta* frame_meta = static_cast<NvDsFrameMeta*>(l->data);
+            frames.push_back({ frame_meta->source_id, frame_meta->batch_id,
+                frame_meta->buf_pts, (int)frame_meta->source_frame_width,
+                (int)frame_meta->source_frame_height, nullptr });
+        }
+        return true;
+    }
+#endif
+
+    if ((batch_meta = gst_buffer_get_batch_meta(buffer))) {
+        for (guint i = 0; i < batch_meta->frames->len; i++) {
+            GstBatchFrame& frame = g_array_index(batch_meta->frames, GstBatchFrame, i);
+            frames.push_back({ frame.source_id, i, frame.pts,
+                frame.width, frame.height, frame.buffer });
+        }
+        return true;
+    }
+
+    return false;
+}
+
+std::shared_ptr<GstSampleObject> VideoPipeline::MakeSampleObject(
+    GstSample* sample, uint64_t timestamp)
+{
+    // takes over the sample reference like GstSampleObject does
+    return m_samplePool.make(sample, timestamp, &m_videoInfoCache);
+}
+
+bool VideoPipeline::PassthroughEnabled()
+{
+    // v4l2src gives jpeg, a batch has no single stream to pass
+    return m_config.rtmp_passthrough && m_config.batch_sources.empty() &&
+        m_config.input_type != VideoType::USB_CAMERE;
+}
+
+bool VideoPipeline::ReconnectEnabled()
+{
+    return m_config.reconnect_timeout > 0 && m_config.batch_sources.empty() &&
+        g_str_has_prefix(m_config.src_uri.c_str(), "rtsp://");
+}
+
+void VideoPipeline::ScheduleReconnect(const std::string& reason)
+{
+    g_mutex_lock(&m_mutex);
+
+    if (m_reconnectSource || m_isExited) {
+        g_mutex_unlock(&m_mutex);
+        return;
+    }
+
+    // doubled on every attempt until a buffer comes through
+    int attempts = m_reconnectAttempts++;
+    guint delay = MIN((guint64)m_config.reconnect_interval << MIN(attempts, 16),
+        (guint64)m_config.reconnect_max_interval);
+
+    LOG_WARN("Pipeline[{}]: {}, rebuild source in {}ms (attempt {})",
+        m_config.pipeline_id, reason, delay, attempts + 1);
+
+    m_reconnectSource = g_timeout_source_new(delay);
+    g_source_set_callback(m_reconnectSource, cb_reconnect_source, this, nullptr);
+    g_source_attach(m_reconnectSource, m_context);
+
+    g_mutex_unlock(&m_mutex);
+}
+
+bool VideoPipeline::RebuildSource()
+{
+    GstElement* source;
+
+    if (m_source) {
+        gst_element_set_state(m_source, GST_STATE_NULL);
+        // unlinks it from tee0 as well
+        gst_bin_remove(GST_BIN(m_pipeline), m_source);
+        m_source = nullptr;
+    }
+
+    // the decoder went away with the old uridecodebin
+    if (m_decoder) {
+        gst_object_unref(m_decoder);
+        m_decoder = nullptr;
+    }
+
+    // the new source gets a full timeout before it's considered stalled
+    m_lastBufferTime = g_get_monotonic_time();
+
+    if (!(source = CreateUridecodebin(m_config.src_uri, 0))) {
+        LOG_ERROR("Pipeline[{}]: failed to rebuild source", m_config.pipeline_id);
+        return false;
+    }
+
+    if (!gst_element_sync_state_with_parent(source)) {
+        LOG_ERROR("Pipeline[{}]: failed to sync state of {}", m_config.pipeline_id,
+            GST_ELEMENT_NAME(source));
+    }
+    m_source = source;
+
+    return true;
+}
+
+LatencyStats VideoPipeline::GetLatencyStats(LatencyBranch branch)
+{
+    return m_latencyTracer.Query(branch);
+}
+
+void VideoPipeline::DumpLatency()
+{
+    for (int i = 0; i < LATENCY_BRANCH_NUM; i++) {
+        LatencyBranch branch = static_cast<LatencyBranch>(i);
+        LatencyStats stats = m_latencyTracer.Query(branch);
+
+        if (!stats.count) {
+            continue;
+        }
+
+        LOG_INFO("Pipeline[{}]: {} latency(us) p50: {}, p95: {}, p99: {}, max: {}, frames: {}",
+            m_config.pipeline_id, LatencyTracer::BranchName(branch),
+            stats.p50, stats.p95, stats.p99, stats.max, stats.count);
+    }
+}
+
+bool VideoPipeline::AttachBranch(OutputBranch branch)
+{
+    static const char* heads[OUTPUT_BRANCH_NUM] = { "queue10", "queue11", "queue01" };
+    GstElement* element;
+    bool ret = false;
+
+    if (branch < DISPLAY_BRANCH || branch >= OUTPUT_BRANCH_NUM) {
+        LOG_ERROR("Pipeline[{}]: invalid branch {}", m_config.pipeline_id, (int)branch);
+        return false;
+    }
+
+    g_mutex_lock(&m_mutex);
+
+    if (!m_pipeline || m_isExited) {
+        LOG_WARN("Pipeline[{}]: not created, can't attach {} branch",
+            m_config.pipeline_id, BranchName(branch));
+        goto exit;
+    }
+
+    // the probe on the parser pushes into rtmpsrc0 without any lock
+    if (branch == RTMP_BRANCH && PassthroughEnabled()) {
+        LOG_WARN("Pipeline[{}]: passthrough rtmp branch can't be attached at runtime",
+            m_config.pipeline_id);
+        goto exit;
+    }
+
+    if (branch != INFERENCE_BRANCH && !m_tee1) {
+        LOG_WARN("Pipeline[{}]: {} branch isn't supported by cpubatchmux",
+            m_config.pipeline_id, BranchName(branch));
+        goto exit;
+    }
+
+    if (!BranchElements(branch).empty()) {
+        LOG_WARN("Pipeline[{}]: {} branch is attached already",
+            m_config.pipeline_id, BranchName(branch));
+        goto exit;
+    }
+
+    // elements of a detached branch leave the bin in the main context
+    if ((element = gst_bin_get_by_name(GST_BIN(m_pipeline), heads[branch]))) {
+        gst_object_unref(element);
+        LOG_WARN("Pipeline[{}]: {} branch is still being detached",
+            m_config.pipeline_id, BranchName(branch));
+        goto exit;
+    }
+
+    switch (branch) {
+        case DISPLAY_BRANCH:
+            ret = CreateDisplayBranch();
+            break;
+        case RTMP_BRANCH:
+            ret = CreateRtmpBranch();
+            break;
+        default:
+            ret = CreateInferenceBranch();
+            break;
+    }
+
+    if (!ret) {
+        LOG_ERROR("Pipeline[{}]: failed to attach {} branch",
+            m_config.pipeline_id, BranchName(branch));
+        for (GstElement* element : BranchElements(branch)) {
+            gst_element_set_state(element, GST_STATE_NULL);
+            gst_bin_remove(GST_BIN(m_pipeline), element);
+        }
+        ClearBranch(branch);
+        goto exit;
+    }
+
+    switch (branch) {
+        case DISPLAY_BRANCH:
+            m_config.enable_hdmi = true;
+            break;
+        case RTMP_BRANCH:
+            m_config.enable_rtmp = true;
+            break;
+        default:
+            m_config.enable_appsink = true;
+            break;
+    }
+
+    LOG_INFO("Pipeline[{}]: {} branch attached", m_config.pipeline_id, BranchName(branch));
+
+exit:
+    g_mutex_unlock(&m_mutex);
+    return ret;
+}
+
+bool VideoPipeline::DetachBranch(OutputBranch branch)
+{
+    std::vector<GstElement*> elements;
+    BranchRemoval* removal;
+    GstPad* sinkpad;
+    GstPad* teepad;
+    bool ret = false;
+
+    if (branch < DISPLAY_BRANCH || branch >= OUTPUT_BRANCH_NUM) {
+        LOG_ERROR("Pipeline[{}]: invalid branch {}", m_config.pipeline_id, (int)branch);
+        return false;
+    }
+
+    g_mutex_lock(&m_mutex);
+
+    if (!m_pipeline || m_isExited) {
+        LOG_WARN("Pipeline[{}]: not created, can't detach {} branch",
+            m_config.pipeline_id, BranchName(branch));
+        goto exit;
+    }
+
+    if (branch == RTMP_BRANCH && PassthroughEnabled()) {
+        LOG_WARN("Pipeline[{}]: passthrough rtmp branch can't be detached at runtime",
+            m_config.pipeline_id);
+        goto exit;
+    }
+
+    elements = BranchElements(branch);
+    if (elements.empty()) {
+        LOG_WARN("Pipeline[{}]: {} branch isn't attached",
+            m_config.pipeline_id, BranchName(branch));
+        goto exit;
+    }
+
+    sinkpad = gst_element_get_static_pad(elements.front(), "sink");
+    teepad = gst_pad_get_peer(sinkpad);
+    gst_object_unref(sinkpad);
+    if (!teepad) {
+        LOG_ERROR("Pipeline[{}]: {} branch isn't linked to a tee",
+            m_config.pipeline_id, BranchName(branch));
+        goto exit;
+    }
+
+    removal = new BranchRemoval();
+    removal->pipeline = GST_ELEMENT(gst_object_ref(m_pipeline));
+    removal->context = m_context ? g_main_context_ref(m_context) : nullptr;
+    removal->tee = GST_ELEMENT(gst_pad_get_parent(teepad));
+    removal->teepad = teepad;
+    removal->name = BranchName(branch);
+    removal->unlinked = FALSE;
+    for (GstElement* element : elements) {
+        removal->elements.push_back(GST_ELEMENT(gst_object_ref(element)));
+    }
+
+    // the new owner is the removal, a following attach creates new elements
+    ClearBranch(branch);
+
+    // called right away if tee isn't pushing, or once the running push is done
+    gst_pad_add_probe(teepad, GST_PAD_PROBE_TYPE_IDLE, cb_unlink_branch_probe,
+        removal, nullptr);
+    ret = true;
+
+exit:
+    g_mutex_unlock(&m_mutex);
+    return ret;
+}
+
+const char* VideoPipeline::BranchName(OutputBranch branch)
+{
+    static const char* names[OUTPUT_BRANCH_NUM] = { "display", "rtmp", "inference" };
+    return names[branch];
+}
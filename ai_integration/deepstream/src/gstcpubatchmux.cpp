@@ -0,0 +1,328 @@
+/*
+ * @Description: CPU stand-in of nvstreammux.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 16:24:10
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 16:24:10
+ */
+
+#include <stdio.h>
+
+#include "gstcpubatchmux.h"
+
+#define GST_CAT_DEFAULT cpu_batch_mux_debug
+GST_DEBUG_CATEGORY_STATIC (cpu_batch_mux_debug);
+
+#define gst_cpu_batch_mux_parent_class parent_class
+G_DEFINE_TYPE (GstCpuBatchMux, gst_cpu_batch_mux, GST_TYPE_AGGREGATOR);
+
+// Default value of plugin properties
+#define DEFAULT_PROP_BATCH_SIZE             0
+
+enum {
+    PROP_0,
+    PROP_BATCH_SIZE
+};
+
+static GstStaticPadTemplate gst_cpu_batch_mux_sink_template =
+    GST_STATIC_PAD_TEMPLATE ("sink_%u", GST_PAD_SINK, GST_PAD_REQUEST,
+        GST_STATIC_CAPS ("video/x-raw(ANY)"));
+
+static GstStaticPadTemplate gst_cpu_batch_mux_src_template =
+    GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+        GST_STATIC_CAPS ("video/x-raw(ANY)"));
+
+/*----------------------------GstBatchMeta----------------------------*/
+
+static void gst_batch_frame_clear(gpointer data)
+{
+    GstBatchFrame *frame = (GstBatchFrame*)data;
+
+    if (frame->buffer) {
+        gst_buffer_unref(frame->buffer);
+        frame->buffer = NULL;
+    }
+}
+
+static gboolean gst_batch_meta_init(GstMeta *meta, gpointer params, GstBuffer *buffer)
+{
+    GstBatchMeta *batch_meta = (GstBatchMeta*)meta;
+
+    batch_meta->frames = g_array_new(FALSE, TRUE, sizeof(GstBatchFrame));
+    g_array_set_clear_func(batch_meta->frames, gst_batch_frame_clear);
+
+    return TRUE;
+}
+
+static void gst_batch_meta_free(GstMeta *meta, GstBuffer *buffer)
+{
+    GstBatchMeta *batch_meta = (GstBatchMeta*)meta;
+
+    if (batch_meta->frames) {
+        g_array_unref(batch_meta->frames);
+        batch_meta->frames = NULL;
+    }
+}
+
+static gboolean gst_batch_meta_transform(GstBuffer *transbuf, GstMeta *meta,
+    GstBuffer *buffer, GQuark type, gpointer data)
+{
+    GstBatchMeta *src = (GstBatchMeta*)meta;
+    GstBatchMeta *dst;
+
+    if (!GST_META_TRANSFORM_IS_COPY(type)) {
+        return FALSE;
+    }
+
+    if (!(dst = gst_buffer_add_batch_meta(transbuf))) {
+        return FALSE;
+    }
+
+    for (guint i = 0; i < src->frames->len; i++) {
+        GstBatchFrame frame = g_array_index(src->frames, GstBatchFrame, i);
+        gst_buffer_ref(frame.buffer);
+        g_array_append_val(dst->frames, frame);
+    }
+
+    return TRUE;
+}
+
+GType gst_batch_meta_api_get_type(void)
+{
+    static gsize type = 0;
+    static const gchar *tags[] = { NULL };
+
+    if (g_once_init_enter(&type)) {
+        GType _type = gst_meta_api_type_register("GstBatchMetaAPI", tags);
+        g_once_init_leave(&type, _type);
+    }
+
+    return (GType)type;
+}
+
+const GstMetaInfo* gst_batch_meta_get_info(void)
+{
+    static const GstMetaInfo *meta_info = NULL;
+
+    if (g_once_init_enter((GstMetaInfo**)&meta_info)) {
+        const GstMetaInfo *mi = gst_meta_register(GST_BATCH_META_API_TYPE,
+            "GstBatchMeta", sizeof(GstBatchMeta), gst_batch_meta_init,
+            gst_batch_meta_free, gst_batch_meta_transform);
+        g_once_init_leave((GstMetaInfo**)&meta_info, (GstMetaInfo*)mi);
+    }
+
+    return meta_info;
+}
+
+GstBatchMeta* gst_buffer_add_batch_meta(GstBuffer* buffer)
+{
+    return (GstBatchMeta*)gst_buffer_add_meta(buffer, GST_BATCH_META_INFO, NULL);
+}
+
+/*---------------------------GstCpuBatchMux---------------------------*/
+
+static void gst_cpu_batch_mux_set_property(GObject *object, guint prop_id,
+    const GValue *value, GParamSpec *pspec)
+{
+    GstCpuBatchMux *mux = GST_CPU_BATCH_MUX(object);
+
+    GST_OBJECT_LOCK(mux);
+    switch (prop_id) {
+    case PROP_BATCH_SIZE:
+        mux->batch_size = g_value_get_uint(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(mux);
+}
+
+static void gst_cpu_batch_mux_get_property(GObject *object, guint prop_id,
+    GValue *value, GParamSpec *pspec)
+{
+    GstCpuBatchMux *mux = GST_CPU_BATCH_MUX(object);
+
+    GST_OBJECT_LOCK(mux);
+    switch (prop_id) {
+    case PROP_BATCH_SIZE:
+        g_value_set_uint(value, mux->batch_size);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(mux);
+}
+
+static gboolean gst_cpu_batch_mux_sink_event(GstAggregator *agg,
+    GstAggregatorPad *pad, GstEvent *event)
+{
+    // caps of the batch follow the caps of the sources
+    if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+        gst_pad_mark_reconfigure(GST_AGGREGATOR_SRC_PAD(agg));
+    }
+
+    return GST_AGGREGATOR_CLASS(parent_class)->sink_event(agg, pad, event);
+}
+
+static GstFlowReturn gst_cpu_batch_mux_update_src_caps(GstAggregator *agg,
+    GstCaps *caps, GstCaps **ret)
+{
+    GstCpuBatchMux *mux = GST_CPU_BATCH_MUX(agg);
+    GstCaps *sink_caps = NULL;
+    guint batch_size;
+
+    GST_OBJECT_LOCK(mux);
+    for (GList *l = GST_ELEMENT(mux)->sinkpads; l && !sink_caps; l = l->next) {
+        sink_caps = gst_pad_get_current_caps(GST_PAD(l->data));
+    }
+    batch_size = mux->batch_size ? mux->batch_size : GST_ELEMENT(mux)->numsinkpads;
+    GST_OBJECT_UNLOCK(mux);
+
+    if (!sink_caps) {
+        return GST_AGGREGATOR_FLOW_NEED_DATA;
+    }
+
+    // caps of the first source, the real size of each frame is in GstBatchMeta
+    *ret = gst_caps_make_writable(sink_caps);
+    gst_caps_set_simple(*ret, "batch-size", G_TYPE_INT, (gint)batch_size, NULL);
+
+    GST_DEBUG_OBJECT(mux, "src caps: %" GST_PTR_FORMAT, *ret);
+
+    return GST_FLOW_OK;
+}
+
+static GstFlowReturn gst_cpu_batch_mux_aggregate(GstAggregator *agg, gboolean timeout)
+{
+    GstCpuBatchMux *mux = GST_CPU_BATCH_MUX(agg);
+    GstClockTime out_pts = GST_CLOCK_TIME_NONE;
+    gboolean all_eos = TRUE;
+    GstBatchMeta *meta;
+    GstBuffer *outbuf;
+    guint numpads, batch_size;
+
+    outbuf = gst_buffer_new();
+    meta = gst_buffer_add_batch_meta(outbuf);
+
+    GST_OBJECT_LOCK(mux);
+    numpads = GST_ELEMENT(mux)->numsinkpads;
+    batch_size = mux->batch_size ? mux->batch_size : numpads;
+
+    for (guint i = 0; i < numpads && meta->frames->len < batch_size; i++) {
+        guint index = (mux->next_pad + i) % numpads;
+        GstAggregatorPad *pad = GST_AGGREGATOR_PAD(
+            g_list_nth_data(GST_ELEMENT(mux)->sinkpads, index));
+        GstBatchFrame frame = { 0, GST_CLOCK_TIME_NONE, 0, 0, NULL };
+        GstClockTime running_time;
+        GstCaps *caps;
+
+        if (!(frame.buffer = gst_aggregator_pad_pop_buffer(pad))) {
+            if (!gst_aggregator_pad_is_eos(pad)) {
+                all_eos = FALSE;
+            }
+            continue;
+        }
+        all_eos = FALSE;
+
+        sscanf(GST_PAD_NAME(pad), "sink_%u", &frame.source_id);
+        frame.pts = GST_BUFFER_PTS(frame.buffer);
+
+        if ((caps = gst_pad_get_current_caps(GST_PAD(pad)))) {
+            GstStructure *s = gst_caps_get_structure(caps, 0);
+            gst_structure_get_int(s, "width", &frame.width);
+            gst_structure_get_int(s, "height", &frame.height);
+            gst_caps_unref(caps);
+        }
+
+        running_time = gst_segment_to_running_time(&pad->segment,
+            GST_FORMAT_TIME, frame.pts);
+        if (GST_CLOCK_TIME_IS_VALID(running_time) &&
+            (!GST_CLOCK_TIME_IS_VALID(out_pts) || running_time < out_pts)) {
+            out_pts = running_time;
+        }
+
+        g_array_append_val(meta->frames, frame);
+    }
+
+    if (numpads) {
+        mux->next_pad = (mux->next_pad + 1) % numpads;
+    }
+    GST_OBJECT_UNLOCK(mux);
+
+    if (meta->frames->len == 0) {
+        gst_buffer_unref(outbuf);
+        // timeout without any frame keeps waiting
+        return all_eos ? GST_FLOW_EOS : GST_FLOW_OK;
+    }
+
+    GST_BUFFER_PTS(outbuf) = out_pts;
+    if (GST_CLOCK_TIME_IS_VALID(out_pts)) {
+        GST_AGGREGATOR_PAD(GST_AGGREGATOR_SRC_PAD(agg))->segment.position = out_pts;
+    }
+
+    GST_LOG_OBJECT(mux, "batch of %u frames, pts %" GST_TIME_FORMAT ", timeout: %d",
+        meta->frames->len, GST_TIME_ARGS(out_pts), timeout);
+
+    return gst_aggregator_finish_buffer(agg, outbuf);
+}
+
+static gboolean gst_cpu_batch_mux_stop(GstAggregator *agg)
+{
+    GstCpuBatchMux *mux = GST_CPU_BATCH_MUX(agg);
+
+    mux->next_pad = 0;
+
+    return TRUE;
+}
+
+static void gst_cpu_batch_mux_init(GstCpuBatchMux *mux)
+{
+    mux->batch_size = DEFAULT_PROP_BATCH_SIZE;
+    mux->next_pad = 0;
+}
+
+static void gst_cpu_batch_mux_class_init(GstCpuBatchMuxClass *klass)
+{
+    GObjectClass *gobject       = G_OBJECT_CLASS(klass);
+    GstElementClass *element    = GST_ELEMENT_CLASS(klass);
+    GstAggregatorClass *agg     = GST_AGGREGATOR_CLASS(klass);
+
+    /* define virtual function pointers */
+    gobject->set_property = GST_DEBUG_FUNCPTR(gst_cpu_batch_mux_set_property);
+    gobject->get_property = GST_DEBUG_FUNCPTR(gst_cpu_batch_mux_get_property);
+
+    /* define properties */
+    g_object_class_install_property(gobject, PROP_BATCH_SIZE,
+        g_param_spec_uint("batch-size", "Batch size",
+            "Max number of frames in a batch, 0 for the number of sink pads.",
+            0, G_MAXUINT, DEFAULT_PROP_BATCH_SIZE,
+            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    gst_element_class_set_static_metadata(element,
+        "CPU batch muxer",
+        "Muxer/Video",
+        "Batch frames of several sources with per-source meta, CPU stand-in of nvstreammux.",
+        "Ricardo Lu<shenglu1202@163.com>");
+
+    /* define pads */
+    gst_element_class_add_static_pad_template_with_gtype(element,
+        &gst_cpu_batch_mux_sink_template, GST_TYPE_AGGREGATOR_PAD);
+    gst_element_class_add_static_pad_template_with_gtype(element,
+        &gst_cpu_batch_mux_src_template, GST_TYPE_AGGREGATOR_PAD);
+
+    agg->sink_event      = GST_DEBUG_FUNCPTR(gst_cpu_batch_mux_sink_event);
+    agg->update_src_caps = GST_DEBUG_FUNCPTR(gst_cpu_batch_mux_update_src_caps);
+    agg->aggregate       = GST_DEBUG_FUNCPTR(gst_cpu_batch_mux_aggregate);
+    agg->stop            = GST_DEBUG_FUNCPTR(gst_cpu_batch_mux_stop);
+    agg->get_next_time   = gst_aggregator_simple_get_next_time;
+
+    GST_DEBUG_CATEGORY_INIT(cpu_batch_mux_debug, "cpubatchmux", 0, "CPU batch muxer");
+}
+
+gboolean gst_cpu_batch_mux_register(void)
+{
+    return gst_element_register(NULL, "cpubatchmux", GST_RANK_NONE,
+        GST_TYPE_CPU_BATCH_MUX);
+}
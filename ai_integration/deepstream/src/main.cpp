@@ -4,7 +4,7 @@
  * @Author: Ricardo Lu<shenglu1202@163.com>
  * @Date: 2022-07-15 22:07:33
  * @LastEditors: Ricardo Lu
- * @LastEditTime: 2023-02-06 20:45:00
+ * @LastEditTime: 2026-10-18 04:44:19
  */
 
 #include <sys/stat.h>
@@ -14,27 +14,66 @@
 
 #include <jsoncpp/json/json.h>
 #include <gflags/gflags.h>
+#ifdef ENABLE_DEEPSTREAM
 #include <gstnvdsmeta.h>
 #include <nvbufsurface.h>
+#endif
 
 #include "Common.h"
 #include "VideoPipeline.h"
+#include "PipelineManager.h"
 #include "DoubleBufferCache.h"
 
-static GMainLoop* g_main_loop = NULL;
 Json::Reader g_reader;
 
-static void Parse(VideoPipelineConfig& config, std::string& config_path)
+static void ParseQueue(QueueConfig& config, const Json::Value& root,
+    const std::string& pipeline_id, const std::string& name)
 {
-    Json::Value root;
-    std::ifstream in(config_path, std::ios::binary);
-    g_reader.parse(in, root);
+    if (root.isMember("max-buffers")) {
+        config.max_buffers = root["max-buffers"].asUInt();
+    }
+    if (root.isMember("max-bytes")) {
+        config.max_bytes = root["max-bytes"].asUInt();
+    }
+    if (root.isMember("max-time-ms")) {
+        config.max_time = root["max-time-ms"].asUInt64() * GST_MSECOND;
+    }
+    if (root.isMember("leaky")) {
+        std::string leaky = root["leaky"].asString();
+        if (leaky == "upstream") {
+            config.leaky = 1;
+        } else if (leaky == "downstream") {
+            config.leaky = 2;
+        } else if (leaky == "no") {
+            config.leaky = 0;
+        } else {
+            LOG_WARN("Pipeline[{}]: unknown leaky mode '{}' of {}, use 'no'",
+                pipeline_id, leaky, name);
+            config.leaky = 0;
+        }
+    }
 
+    LOG_INFO("Pipeline[{}]: {} max-buffers: {}, max-bytes: {}, max-time: {}ms, leaky: {}",
+        pipeline_id, name, config.max_buffers, config.max_bytes,
+        config.max_time / GST_MSECOND, config.leaky);
+}
+
+static void Parse(VideoPipelineConfig& config, const Json::Value& root)
+{
     if (root.isMember("name")) {
         config.pipeline_id = root["name"].asString();
         LOG_INFO("New pieline name: {}", config.pipeline_id);
     }
 
+    // nvidia, qti or software
+    if (root.isMember("backend")) {
+        if (!ParseBackend(root["backend"].asString(), config.backend)) {
+            LOG_WARN("Pipeline[{}]: unknown backend {}, use {}", config.pipeline_id,
+                root["backend"].asString(), GetBackendProfile(config.backend).name);
+        }
+        LOG_INFO("Pipeline[{}]: backend: {}", config.pipeline_id, GetBackendProfile(config.backend).name);
+    }
+
     if (root.isMember("input-config")) {
         Json::Value inputConfig = root["input-config"];
         config.input_type = inputConfig["type"].asInt();    // 0-MP4 / 1-RTSP / 2-USB Camera
@@ -44,8 +83,24 @@ static void Parse(VideoPipelineConfig& config, std::string& config_path)
         LOG_INFO("Pipeline[{}]: input: {}", config.pipeline_id, config.src_uri);
         config.file_loop = inputConfig["stream"]["file-loop"].asBool();
         LOG_INFO("Pipeline[{}]: file-loop: {}", config.pipeline_id, config.file_loop);
+        if (inputConfig["stream"].isMember("gapless-loop")) {
+            config.gapless_loop = inputConfig["stream"]["gapless-loop"].asBool();
+            LOG_INFO("Pipeline[{}]: gapless-loop: {}", config.pipeline_id, config.gapless_loop);
+        }
         config.rtsp_latency = inputConfig["stream"]["rtsp-latency"].asInt();
         LOG_INFO("Pipeline[{}]: rtsp-latency: {}", config.pipeline_id, config.rtsp_latency);
+        if (inputConfig["stream"].isMember("reconnect-timeout")) {
+            config.reconnect_timeout = inputConfig["stream"]["reconnect-timeout"].asInt();
+            LOG_INFO("Pipeline[{}]: reconnect-timeout: {}ms", config.pipeline_id, config.reconnect_timeout);
+        }
+        if (inputConfig["stream"].isMember("reconnect-interval")) {
+            config.reconnect_interval = inputConfig["stream"]["reconnect-interval"].asInt();
+            LOG_INFO("Pipeline[{}]: reconnect-interval: {}ms", config.pipeline_id, config.reconnect_interval);
+        }
+        if (inputConfig["stream"].isMember("reconnect-max-interval")) {
+            config.reconnect_max_interval = inputConfig["stream"]["reconnect-max-interval"].asInt();
+            LOG_INFO("Pipeline[{}]: reconnect-max-interval: {}ms", config.pipeline_id, config.reconnect_max_interval);
+        }
         config.rtp_protocol = inputConfig["stream"]["rtp-protocol"].asInt();
         LOG_INFO("Pipeline[{}]: rtp-protocol: {}", config.pipeline_id, config.rtp_protocol);
         config.src_device = inputConfig["usb-camera"]["device"].asString();
@@ -60,10 +115,67 @@ static void Parse(VideoPipelineConfig& config, std::string& config_path)
         LOG_INFO("Pipeline[{}]: usb camera output height: {}", config.pipeline_id, config.src_framerate_n);
         config.src_framerate_d = inputConfig["usb-camera"]["framerate-d"].asInt();
         LOG_INFO("Pipeline[{}]: usb camera output height: {}", config.pipeline_id, config.src_framerate_d);
+
+        if (inputConfig.isMember("batch")) {
+            Json::Value batchConfig = inputConfig["batch"];
+            if (batchConfig.isMember("muxer")) {
+                config.batch_muxer = batchConfig["muxer"].asString();
+            }
+            LOG_INFO("Pipeline[{}]: batch muxer: {}", config.pipeline_id, config.batch_muxer);
+            if (batchConfig.isMember("width")) {
+                config.batch_width = batchConfig["width"].asInt();
+            }
+            if (batchConfig.isMember("height")) {
+                config.batch_height = batchConfig["height"].asInt();
+            }
+            LOG_INFO("Pipeline[{}]: batch resolution: {}x{}", config.pipeline_id, config.batch_width, config.batch_height);
+            if (batchConfig.isMember("batched-push-timeout")) {
+                config.batch_timeout = batchConfig["batched-push-timeout"].asInt();
+            }
+            LOG_INFO("Pipeline[{}]: batched-push-timeout: {}", config.pipeline_id, config.batch_timeout);
+            config.batch_live_source = batchConfig["live-source"].asBool();
+            LOG_INFO("Pipeline[{}]: batch live-source: {}", config.pipeline_id, config.batch_live_source);
+
+            for (const Json::Value& sourceConfig : batchConfig["sources"]) {
+                VideoSourceConfig source;
+                source.source_id = sourceConfig.isMember("id") ?
+                    sourceConfig["id"].asInt() : (int)config.batch_sources.size();
+                source.src_uri = sourceConfig["uri"].asString();
+                LOG_INFO("Pipeline[{}]: batch source {}: {}", config.pipeline_id, source.source_id, source.src_uri);
+                config.batch_sources.push_back(source);
+            }
+        }
+    }
+
+    if (root.isMember("latency-trace")) {
+        Json::Value traceConfig = root["latency-trace"];
+        config.enable_latency_trace = traceConfig["enable"].asBool();
+        LOG_INFO("Pipeline[{}]: enable-latency-trace: {}", config.pipeline_id, config.enable_latency_trace);
+        if (traceConfig.isMember("dump-interval")) {
+            config.latency_dump_interval = traceConfig["dump-interval"].asInt();
+            LOG_INFO("Pipeline[{}]: latency dump interval: {}s", config.pipeline_id, config.latency_dump_interval);
+        }
     }
 
     if (root.isMember("output-config")) {
         Json::Value outputConfig = root["output-config"];
+        // queue00 is shared by display and rtmp
+        if (outputConfig.isMember("queue")) {
+            ParseQueue(config.queue00, outputConfig["queue"], config.pipeline_id, "queue00");
+        }
+
+        // e.g. "osd":{"max-delay-ms":200, "min-delay-ms":0, "percentile":95}
+        if (outputConfig.isMember("osd")) {
+            Json::Value osdConfig = outputConfig["osd"];
+            config.osd_max_delay = osdConfig["max-delay-ms"].asInt();
+            config.osd_min_delay = osdConfig["min-delay-ms"].asInt();
+            if (osdConfig.isMember("percentile")) {
+                config.osd_delay_percentile = osdConfig["percentile"].asDouble();
+            }
+            LOG_INFO("Pipeline[{}]: osd delay: {}~{}ms, p{}", config.pipeline_id,
+                config.osd_min_delay, config.osd_max_delay, config.osd_delay_percentile);
+        }
+
         if (outputConfig.isMember("display")) {
             Json::Value displayConfig = outputConfig["display"];
             config.enable_hdmi = displayConfig["enable"].asBool();
@@ -78,6 +190,9 @@ static void Parse(VideoPipelineConfig& config, std::string& config_path)
             LOG_INFO("Pipeline[{}]: window-width: {}", config.pipeline_id, config.window_width);
             config.window_height = displayConfig["height"].asInt();
             LOG_INFO("Pipeline[{}]: window-height: {}", config.pipeline_id, config.window_height);
+            if (displayConfig.isMember("queue")) {
+                ParseQueue(config.queue10, displayConfig["queue"], config.pipeline_id, "queue10");
+            }
         }
 
         if (outputConfig.isMember("rtmp")) {
@@ -90,6 +205,31 @@ static void Parse(VideoPipelineConfig& config, std::string& config_path)
             LOG_INFO("Pipeline[{}]: encode-iframeinterval: {}", config.pipeline_id, config.enc_iframe_interval);
             config.rtmp_uri = rtmpConfig["uri"].asString();
             LOG_INFO("Pipeline[{}]: rtmp-uri: {}", config.pipeline_id, config.rtmp_uri);
+            if (rtmpConfig.isMember("passthrough")) {
+                config.rtmp_passthrough = rtmpConfig["passthrough"].asBool();
+                LOG_INFO("Pipeline[{}]: rtmp-passthrough: {}", config.pipeline_id, config.rtmp_passthrough);
+            }
+            if (rtmpConfig.isMember("queue")) {
+                ParseQueue(config.queue11, rtmpConfig["queue"], config.pipeline_id, "queue11");
+            }
+        }
+
+        // e.g. "record":{"enable":true, "pre-event-s":10, "post-event-s":10, "max-bytes":33554432}
+        if (outputConfig.isMember("record")) {
+            Json::Value recordConfig = outputConfig["record"];
+            config.enable_record = recordConfig["enable"].asBool();
+            LOG_INFO("Pipeline[{}]: enable-record: {}", config.pipeline_id, config.enable_record);
+            if (recordConfig.isMember("pre-event-s")) {
+                config.record_pre_event = recordConfig["pre-event-s"].asInt();
+            }
+            if (recordConfig.isMember("post-event-s")) {
+                config.record_post_event = recordConfig["post-event-s"].asInt();
+            }
+            if (recordConfig.isMember("max-bytes")) {
+                config.record_max_bytes = recordConfig["max-bytes"].asInt();
+            }
+            LOG_INFO("Pipeline[{}]: record {}s before, {}s after, max {} bytes", config.pipeline_id,
+                config.record_pre_event, config.record_post_event, config.record_max_bytes);
         }
 
         if (outputConfig.isMember("inference")) {
@@ -100,10 +240,95 @@ static void Parse(VideoPipelineConfig& config, std::string& config_path)
             LOG_INFO("Pipeline[{}]: videoconvert memory type: {}", config.pipeline_id, config.cvt_memory_type);
             config.cvt_format = inferenceConfig["format"].asString();
             LOG_INFO("Pipeline[{}]: videoconvert format: {}", config.pipeline_id, config.cvt_format);
+            if (inferenceConfig.isMember("width") && inferenceConfig.isMember("height")) {
+                config.cvt_width = inferenceConfig["width"].asInt();
+                config.cvt_height = inferenceConfig["height"].asInt();
+                LOG_INFO("Pipeline[{}]: videoconvert size: {}x{}", config.pipeline_id,
+                    config.cvt_width, config.cvt_height);
+            }
+            if (inferenceConfig.isMember("crop")) {
+                config.crop = inferenceConfig["crop"].asString();
+                LOG_INFO("Pipeline[{}]: videoconvert crop: {}", config.pipeline_id, config.crop);
+            }
+            if (inferenceConfig.isMember("pool-size")) {
+                config.sample_pool_size = inferenceConfig["pool-size"].asInt();
+                LOG_INFO("Pipeline[{}]: sample pool size: {}", config.pipeline_id, config.sample_pool_size);
+            }
+            if (inferenceConfig.isMember("infer-fps")) {
+                config.infer_fps = inferenceConfig["infer-fps"].asDouble();
+                LOG_INFO("Pipeline[{}]: inference fps: {}", config.pipeline_id, config.infer_fps);
+            }
+            if (inferenceConfig.isMember("adaptive-rate")) {
+                config.adaptive_infer = inferenceConfig["adaptive-rate"].asBool();
+                LOG_INFO("Pipeline[{}]: adaptive inference rate: {}", config.pipeline_id, config.adaptive_infer);
+            }
+            if (inferenceConfig.isMember("max-buffers")) {
+                config.appsink_max_buffers = inferenceConfig["max-buffers"].asUInt();
+                LOG_INFO("Pipeline[{}]: appsink max buffers: {}", config.pipeline_id, config.appsink_max_buffers);
+            }
+            if (inferenceConfig.isMember("drop")) {
+                config.appsink_drop = inferenceConfig["drop"].asBool();
+                LOG_INFO("Pipeline[{}]: appsink drop: {}", config.pipeline_id, config.appsink_drop);
+            }
+            if (inferenceConfig.isMember("wait-on-eos")) {
+                config.appsink_wait_on_eos = inferenceConfig["wait-on-eos"].asBool();
+                LOG_INFO("Pipeline[{}]: appsink wait on eos: {}", config.pipeline_id, config.appsink_wait_on_eos);
+            }
+            if (inferenceConfig.isMember("queue")) {
+                ParseQueue(config.queue01, inferenceConfig["queue"], config.pipeline_id, "queue01");
+            }
+            // e.g. a detector at 640x640 letterboxed and a classifier at 224x224
+            for (const Json::Value& outputConfig : inferenceConfig["outputs"]) {
+                ScaleOutputConfig output;
+                output.name = outputConfig["name"].asString();
+                output.width = outputConfig["width"].asInt();
+                output.height = outputConfig["height"].asInt();
+                output.format = gst_video_format_from_string(outputConfig["format"].asString().c_str());
+                output.letterbox = outputConfig["letterbox"].asBool();
+                output.pad_value = outputConfig.isMember("pad-value") ?
+                    (uint8_t)outputConfig["pad-value"].asUInt() : 114;
+                if (!MultiScaler::Supported(output.format) || output.width <= 0 || output.height <= 0) {
+                    LOG_WARN("Pipeline[{}]: invalid inference output {}, skipped",
+                        config.pipeline_id, output.name);
+                    continue;
+                }
+                LOG_INFO("Pipeline[{}]: inference output {}: {}x{} {}{}", config.pipeline_id,
+                    output.name, output.width, output.height, outputConfig["format"].asString(),
+                    output.letterbox ? " letterbox" : "");
+                config.infer_outputs.push_back(output);
+            }
         }
     }
 }
 
+static bool ParseFile(std::vector<VideoPipelineConfig>& configs, const std::string& config_path)
+{
+    Json::Value root;
+    Json::Value pipelines;
+    std::ifstream in(config_path, std::ios::binary);
+
+    if (!g_reader.parse(in, root)) {
+        LOG_ERROR("Failed to parse config file: {}", config_path);
+        return false;
+    }
+
+    // an array of pipelines, {"pipelines": [...]} or a single pipeline
+    if (root.isArray()) {
+        pipelines = root;
+    } else if (root.isMember("pipelines")) {
+        pipelines = root["pipelines"];
+    } else {
+        pipelines.append(root);
+    }
+
+    for (const Json::Value& pipeline : pipelines) {
+        configs.emplace_back();
+        Parse(configs.back(), pipeline);
+    }
+
+    return !configs.empty();
+}
+
 static bool validateConfigPath(const char* name, const std::string& value) 
 { 
     if (0 == value.compare ("")) {
@@ -122,45 +347,68 @@ static bool validateConfigPath(const char* name, const std::string& value)
 
 DEFINE_string(config_path, "./pipeline.json", "Model config file path.");
 DEFINE_validator(config_path, &validateConfigPath);
+DEFINE_int32(warm_pool, 0, "Standby pipelines built from the first config, all configs are bound to them.");
+DEFINE_int32(restart_max_attempts, 10, "Restarts in a row without a frame before a pipeline is stopped, 0 for no limit.");
 
 int main(int argc, char* argv[])
 {
     google::ParseCommandLineFlags(&argc, &argv, true);
 
-    VideoPipelineConfig m_vpConfig;
-    VideoPipeline *m_vp;
+    std::vector<VideoPipelineConfig> configs;
+    PipelineManager* manager = nullptr;
 
-    Parse(m_vpConfig, FLAGS_config_path);
+    if (!ParseFile(configs, FLAGS_config_path)) {
+        goto exit;
+    }
 
     gst_init(&argc, &argv);
 
     g_setenv("GST_DEBUG_DUMP_DOT_DIR", "/home/ricardo/workSpace/gstreamer-example/ai_integration/deepstream/build", true);
 
-    if (!(g_main_loop = g_main_loop_new(NULL, FALSE))) {
-        LOG_ERROR("Failed to new a object with type GMainLoop");
-        goto exit;
-    }
+    manager = new PipelineManager();
+    manager->SetRestartPolicy(500, 30000, FLAGS_restart_max_attempts);
 
-    m_vp = new VideoPipeline(m_vpConfig);
+    // demo consumer, every frame is done once pulled, its PTS is the result
+    manager->SetCallbacks([](VideoPipeline* vp) {
+        if (!vp->m_config.enable_appsink) {
+            return;
+        }
+        vp->SetCallbacks([vp](GstSample* sample, void* args) -> bool {
+            GstBuffer* buffer = gst_sample_get_buffer(sample);
+            uint64_t pts = buffer ? GST_BUFFER_PTS(buffer) : GST_CLOCK_TIME_NONE;
 
-    if (!m_vp->Create()) {
-        LOG_ERROR("Pipeline Create failed: lack of elements");
-        goto exit;
-    }
+            gst_sample_unref(sample);
+            vp->OnResult(pts);
+            return true;
+        }, nullptr);
+    });
 
-    m_vp->Start();
+    // compare the time to first frame logged with and without --warm_pool
+    if (FLAGS_warm_pool > 0 && manager->SetWarmPool(configs[0], FLAGS_warm_pool)) {
+        for (const VideoPipelineConfig& config : configs) {
+            if (!manager->Bind(config)) {
+                LOG_WARN("Pipeline[{}]: failed to bind", config.pipeline_id);
+            }
+        }
+    } else {
+        for (const VideoPipelineConfig& config : configs) {
+            manager->Add(config);
+        }
 
-    g_main_loop_run(g_main_loop);
+        // pipelines are independent, the ones that started keep running
+        if (!manager->StartAll()) {
+            LOG_WARN("Not all pipelines started");
+        }
+    }
 
-exit:
-    if (g_main_loop) g_main_loop_unref(g_main_loop);
+    manager->Run();
 
-    if (m_vp) {
-        // m_vp->Destroy();
-        delete m_vp;
-        m_vp = NULL;
+exit:
+    if (manager) {
+        delete manager;
+        manager = nullptr;
     }
 
     google::ShutDownCommandLineFlags();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,260 @@
+/*
+ * @Description: Reconnect of an RTSP source against a local gst-rtsp-server.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 21:32:05
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 04:34:36
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gst/gst.h>
+#include <gst/rtsp-server/rtsp-server.h>
+
+#include "VideoPipeline.h"
+
+static const char* MOUNT = "/test";
+static const int RECONNECT_TIMEOUT = 1000;     /* ms */
+static const int RECONNECT_INTERVAL = 200;
+static const int RECONNECT_MAX_INTERVAL = 800;
+static const int ATTEMPTS = 5;                 /* the last backoff hits the max interval */
+static const int SLACK = 400;                  /* a refused DESCRIBE fails at once on loopback */
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        LOG_ERROR("CHECK failed at line {}: {}", __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+/* the stand-in camera, a live test pattern encoded as H.264 */
+typedef struct _TestServer {
+    GstRTSPServer*          server;
+    GstRTSPMountPoints*     mounts;
+    GstRTSPMediaFactory*    factory;
+    guint                   source_id;
+    int                     port;
+}TestServer;
+
+static GstPadProbeReturn cb_count_probe(
+    GstPad* pad,
+    GstPadProbeInfo* info,
+    gpointer user_data)
+{
+    (*static_cast<std::atomic<uint64_t>*>(user_data))++;
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstRTSPFilterResult cb_close_client(GstRTSPServer* server,
+    GstRTSPClient* client, gpointer user_data)
+{
+    return GST_RTSP_FILTER_REMOVE;
+}
+
+static bool start_server(TestServer& ts, GMainContext* context)
+{
+    ts.server = gst_rtsp_server_new();
+    // any free port, read back once bound
+    gst_rtsp_server_set_service(ts.server, "0");
+
+    ts.factory = gst_rtsp_media_factory_new();
+    gst_rtsp_media_factory_set_launch(ts.factory,
+        "( videotestsrc is-live=true pattern=ball ! "
+        "video/x-raw,width=320,height=240,framerate=25/1 ! "
+        "x264enc tune=zerolatency key-int-max=25 ! rtph264pay name=pay0 pt=96 )");
+
+    ts.mounts = gst_rtsp_server_get_mount_points(ts.server);
+    gst_rtsp_mount_points_add_factory(ts.mounts, MOUNT,
+        GST_RTSP_MEDIA_FACTORY(g_object_ref(ts.factory)));
+
+    if (!(ts.source_id = gst_rtsp_server_attach(ts.server, context))) {
+        LOG_ERROR("Failed to attach the rtsp server");
+        return false;
+    }
+    ts.port = gst_rtsp_server_get_bound_port(ts.server);
+
+    return ts.port > 0;
+}
+
+// the camera goes away, the clients are dropped and the mount answers 404
+static void stop_serving(TestServer& ts)
+{
+    gst_rtsp_mount_points_remove_factory(ts.mounts, MOUNT);
+    gst_rtsp_server_client_filter(ts.server, cb_close_client, nullptr);
+}
+
+static void resume_serving(TestServer& ts)
+{
+    gst_rtsp_mount_points_add_factory(ts.mounts, MOUNT,
+        GST_RTSP_MEDIA_FACTORY(g_object_ref(ts.factory)));
+}
+
+static void destroy_server(TestServer& ts, GMainContext* context)
+{
+    GSource* source;
+
+    if (ts.source_id && (source = g_main_context_find_source_by_id(context, ts.source_id))) {
+        g_source_destroy(source);
+    }
+    if (ts.mounts) {
+        g_object_unref(ts.mounts);
+    }
+    if (ts.factory) {
+        g_object_unref(ts.factory);
+    }
+    if (ts.server) {
+        gst_rtsp_server_client_filter(ts.server, cb_close_client, nullptr);
+        g_object_unref(ts.server);
+    }
+}
+
+// dispatches the pipeline timers and the server until done or timeout
+static bool run_until(GMainContext* context, int timeout_ms, const std::function<bool()>& done)
+{
+    int64_t deadline = g_get_monotonic_time() + (int64_t)timeout_ms * 1000;
+
+    while (!done()) {
+        if (g_get_monotonic_time() > deadline) {
+            return false;
+        }
+        while (g_main_context_iteration(context, false));
+        g_usleep(5000);
+    }
+
+    return true;
+}
+
+// direct children of the pipeline by name, not referenced
+static std::map<std::string, GstElement*> get_children(GstElement* pipeline)
+{
+    std::map<std::string, GstElement*> children;
+    GstIterator* it = gst_bin_iterate_elements(GST_BIN(pipeline));
+    GValue item = G_VALUE_INIT;
+
+    while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+        GstElement* element = GST_ELEMENT(g_value_get_object(&item));
+        children[GST_ELEMENT_NAME(element)] = element;
+        g_value_reset(&item);
+    }
+    g_value_unset(&item);
+    gst_iterator_free(it);
+
+    return children;
+}
+
+int main(int argc, char* argv[])
+{
+    GMainContext* context;
+    TestServer ts = { };
+    VideoPipelineConfig config { };
+    VideoPipeline* vp = nullptr;
+    std::atomic<uint64_t> frames(0);
+    std::map<std::string, GstElement*> before, after;
+    std::vector<int64_t> attempts;      /* us, when each rebuild was scheduled */
+    GstElement* old_source = nullptr;
+    GstPad* pad;
+    uint64_t resumed;
+    int seen = 0;
+
+    gst_init(&argc, &argv);
+    context = g_main_context_new();
+
+    if (!start_server(ts, context)) {
+        LOG_ERROR("Failed to start the rtsp server");
+        failures++;
+        goto exit;
+    }
+
+    config.pipeline_id = "reconnect";
+    config.backend = BACKEND_SOFTWARE;
+    config.input_type = VideoType::RTSP_STREAM;
+    config.src_uri = "rtsp://127.0.0.1:" + std::to_string(ts.port) + MOUNT;
+    config.rtp_protocol = GST_RTSP_LOWER_TRANS_TCP;
+    config.reconnect_timeout = RECONNECT_TIMEOUT;
+    config.reconnect_interval = RECONNECT_INTERVAL;
+    config.reconnect_max_interval = RECONNECT_MAX_INTERVAL;
+
+    vp = new VideoPipeline(config, context);
+    if (!vp->Create() || !vp->Start()) {
+        LOG_ERROR("Failed to start the pipeline");
+        failures++;
+        goto exit;
+    }
+
+    pad = gst_element_get_static_pad(vp->m_tee0, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, cb_count_probe, &frames, nullptr);
+    gst_object_unref(pad);
+
+    if (!run_until(context, 15000, [&]() { return frames > 25; })) {
+        LOG_ERROR("No frame from the rtsp server");
+        failures++;
+        goto exit;
+    }
+
+    before = get_children(vp->m_pipeline);
+    // held, so a new uridecodebin can't get its address
+    old_source = GST_ELEMENT(gst_object_ref(vp->m_source));
+
+    stop_serving(ts);
+    CHECK(run_until(context, 20000, [&]() {
+        // a buffer resets the attempts, none is expected while down
+        for (int now = vp->m_reconnectAttempts; seen < now; seen++) {
+            attempts.push_back(g_get_monotonic_time());
+        }
+        return (int)attempts.size() >= ATTEMPTS;
+    }));
+
+    // attempt k is rebuilt interval << (k - 1) after the previous one, capped,
+    // and the rebuilt source fails again right away
+    for (size_t k = 1; k < attempts.size(); k++) {
+        int64_t gap = (attempts[k] - attempts[k - 1]) / 1000;
+        int64_t expected = std::min(RECONNECT_INTERVAL << (k - 1), RECONNECT_MAX_INTERVAL);
+
+        LOG_INFO("attempt {}: {}ms after the previous one, backoff {}ms", k + 1, gap, expected);
+        CHECK(gap >= expected - 20);
+        // under 1600ms, so the last one proves the cap
+        CHECK(gap <= expected + SLACK);
+    }
+
+    resume_serving(ts);
+    resumed = frames;
+    CHECK(run_until(context, 20000, [&]() {
+        return frames > resumed + 25 && vp->m_reconnectAttempts == 0;
+    }));
+
+    // uridecodebin is new, everything behind tee0 is the same object
+    after = get_children(vp->m_pipeline);
+    CHECK(after.size() == before.size());
+    CHECK(vp->m_source && vp->m_source != old_source);
+    CHECK(!GST_OBJECT_PARENT(old_source));
+    for (const auto& child : before) {
+        if (child.second == old_source) {
+            continue;
+        }
+        CHECK(after.count(child.first) && after[child.first] == child.second);
+    }
+    CHECK(after.count(GST_ELEMENT_NAME(vp->m_source)) &&
+        after[GST_ELEMENT_NAME(vp->m_source)] == vp->m_source);
+
+exit:
+    if (vp) {
+        delete vp;
+    }
+    if (old_source) {
+        gst_object_unref(old_source);
+    }
+    destroy_server(ts, context);
+    g_main_context_unref(context);
+
+    LOG_INFO("reconnect_test: {}", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -4,10 +4,11 @@
  * @Author: Ricardo Lu<shenglu1202@163.com>
  * @Date: 2021-08-27 12:01:39
  * @LastEditors: Ricardo Lu
- * @LastEditTime: 2021-09-10 08:16:03
+ * @LastEditTime: 2026-10-18 03:44:09
  */
 
 #include "VideoPipeline.h"
+#include "MappedVideoFrame.h"
 
 static GstPadProbeReturn cb_sync_before_buffer_probe (
     GstPad* pad,
@@ -87,67 +88,34 @@ static GstFlowReturn cb_appsink_new_sample (
 
     VideoPipeline* vp = reinterpret_cast<VideoPipeline*> (user_data);
     GstSample* sample = NULL;
-    GstBuffer* buffer = NULL;
-    GstMapInfo map;
-    const GstStructure* info = NULL;
-    GstCaps* caps = NULL;
-    int sample_width = 0;
-    int sample_height = 0;
+    std::shared_ptr<cv::Mat> img;
 
     g_signal_emit_by_name (appsink, "pull-sample", &sample);
 
     if (sample) {
-        buffer = gst_sample_get_buffer (sample);
-        if ( buffer == NULL ) {
-            LOG_ERROR_MSG ("get buffer is null");
-            goto exit;
-        }
-
-        gst_buffer_map (buffer, &map, GST_MAP_READ);
-
-        caps = gst_sample_get_caps (sample);
-        if ( caps == NULL ) {
-            LOG_ERROR_MSG ("get caps is null");
-            goto exit;
+        // appsink product queue produce
+        // zero-copy: the cv::Mat keeps the sample mapped until it's released,
+        // its step follows the real stride of the frame.
+        img = MappedVideoFrame::Map (sample, GST_MAP_READWRITE);
+        if (!img) {
+            // the buffer is shared, draw on a private deep copy instead
+            img = MappedVideoFrame::Map (sample, GST_MAP_READ);
+            if (img) {
+                img = std::make_shared<cv::Mat> (img->clone());
+            }
         }
 
-        info = gst_caps_get_structure (caps, 0);
-        if ( info == NULL ) {
-            LOG_ERROR_MSG ("get info is null");
+        if (!img) {
+            LOG_ERROR_MSG ("Failed to map appsink sample into cv::Mat");
             goto exit;
         }
 
-        // ---- Read frame and convert to opencv format ---------------
-        // convert gstreamer data to OpenCV Mat, you could actually
-        // resolve height / width from caps...
-        gst_structure_get_int (info, "width", &sample_width);
-        gst_structure_get_int (info, "height", &sample_height);
-
-        // appsink product queue produce
-        {
-            // init a cv::Mat with gst buffer address: deep copy
-            if (map.data == NULL) {
-                LOG_ERROR_MSG("appsink buffer data empty\n");
-                return GST_FLOW_OK;
-            }
-
-            cv::Mat img (sample_height, sample_width, CV_8UC3,
-                        (unsigned char*)map.data, cv::Mat::AUTO_STEP);
-            img = img.clone();
-
-            if (vp->m_putDataFunc) {
-                vp->m_putDataFunc(std::make_shared<cv::Mat> (img),
-                    vp->m_putDataArgs);
-            } else {
-                goto exit;
-            }
+        if (vp->m_putDataFunc) {
+            vp->m_putDataFunc(img, vp->m_putDataArgs);
         }
     }
 
 exit:
-    if (buffer) {
-        gst_buffer_unmap (buffer, &map);
-    }
     if (sample) {
         gst_sample_unref (sample);
     }
@@ -422,6 +390,8 @@ bool VideoPipeline::Create (void)
     }
 
     g_object_set (m_appsink, "emit-signals", TRUE, NULL);
+    // don't hold an extra reference of the last buffer, so it stays writable
+    g_object_set (m_appsink, "enable-last-sample", FALSE, NULL);
 
     g_signal_connect (m_appsink, "new-sample",
         G_CALLBACK (cb_appsink_new_sample), reinterpret_cast<void*> (this));
@@ -4,7 +4,7 @@
  * @Author: Ricardo Lu<shenglu1202@163.com>
  * @Date: 2021-08-28 10:05:59
  * @LastEditors: Ricardo Lu
- * @LastEditTime: 2021-09-01 11:53:47
+ * @LastEditTime: 2026-10-18 03:57:32
  */
 #pragma once
 
@@ -16,6 +16,10 @@ typedef struct _SinkPipelineConfig {
     std::string conv_format;
     int         conv_width;
     int         conv_height;
+    /*----------------appsink----------------*/
+    guint       max_buffers;    /* 0 for unlimited */
+    bool        drop;           /* drop old samples instead of blocking when full */
+    bool        wait_on_eos;
 }SinkPipelineConfig;
 
 class SinkPipeline
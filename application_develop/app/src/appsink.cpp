@@ -4,86 +4,54 @@
  * @Author: Ricardo Lu<shenglu1202@163.com>
  * @Date: 2021-08-28 09:57:03
  * @LastEditors: Ricardo Lu
- * @LastEditTime: 2021-09-01 12:41:27
+ * @LastEditTime: 2026-10-18 03:57:32
  */
 
 #include "appsink.h"
+#include "MappedVideoFrame.h"
 
 GstFlowReturn cb_appsink_new_sample (
-    GstElement* appsink,
+    GstAppSink* appsink,
     gpointer user_data)
 {
     // LOG_INFO_MSG ("cb_appsink_new_sample called, user data: %p", user_data);
 
     SinkPipeline* sp = reinterpret_cast<SinkPipeline*> (user_data);
     GstSample* sample = NULL;
-    GstBuffer* buffer = NULL;
-    GstMapInfo map;
-    const GstStructure* info = NULL;
-    GstCaps* caps = NULL;
-    GstFlowReturn ret = GST_FLOW_OK;
-    int sample_width = 0;
-    int sample_height = 0;
-
-    // equals to gst_app_sink_pull_sample (GST_APP_SINK_CAST (appsink), sample);
-    g_signal_emit_by_name (appsink, "pull-sample", &sample, &ret);
-    if (ret != GST_FLOW_OK) {
-        LOG_ERROR_MSG ("can't pull GstSample.");
-        return ret;
+    std::shared_ptr<cv::Mat> img;
+
+    // called directly by appsink, no signal marshalling per frame
+    sample = gst_app_sink_pull_sample (appsink);
+    if (!sample) {
+        // stopped or eos
+        LOG_WARN_MSG ("can't pull GstSample.");
+        return GST_FLOW_OK;
     }
 
     if (sample) {
-        buffer = gst_sample_get_buffer (sample);
-        if ( buffer == NULL ) {
-            LOG_ERROR_MSG ("get buffer is null");
-            goto exit;
-        }
-
-        gst_buffer_map (buffer, &map, GST_MAP_READ);
-
-        caps = gst_sample_get_caps (sample);
-        if ( caps == NULL ) {
-            LOG_ERROR_MSG ("get caps is null");
-            goto exit;
+        // appsink product queue produce
+        // zero-copy: the cv::Mat keeps the sample mapped until it's released,
+        // its step follows the real stride of the frame.
+        img = MappedVideoFrame::Map (sample, GST_MAP_READWRITE);
+        if (!img) {
+            // the buffer is shared, draw on a private deep copy instead
+            img = MappedVideoFrame::Map (sample, GST_MAP_READ);
+            if (img) {
+                img = std::make_shared<cv::Mat> (img->clone());
+            }
         }
 
-        info = gst_caps_get_structure (caps, 0);
-        if ( info == NULL ) {
-            LOG_ERROR_MSG ("get info is null");
+        if (!img) {
+            LOG_ERROR_MSG ("Failed to map appsink sample into cv::Mat");
             goto exit;
         }
 
-        // ---- Read frame and convert to opencv format ---------------
-        // convert gstreamer data to OpenCV Mat, you could actually
-        // resolve height / width from caps...
-        gst_structure_get_int (info, "width", &sample_width);
-        gst_structure_get_int (info, "height", &sample_height);
-
-        // appsink product queue produce
-        {
-            // init a cv::Mat with gst buffer address: deep copy
-            if (map.data == NULL) {
-                LOG_ERROR_MSG("appsink buffer data empty\n");
-                return GST_FLOW_OK;
-            }
-
-            cv::Mat img (sample_height, sample_width, CV_8UC3,
-                        (unsigned char*)map.data, cv::Mat::AUTO_STEP);
-            img = img.clone();
-
-            if (sp->m_putDataFunc) {
-                sp->m_putDataFunc(std::make_shared<cv::Mat> (img),
-                    sp->m_putDataArgs);
-            } else {
-                goto exit;
-            }
+        if (sp->m_putDataFunc) {
+            sp->m_putDataFunc(img, sp->m_putDataArgs);
         }
     }
 
 exit:
-    if (buffer) {
-        gst_buffer_unmap (buffer, &map);
-    }
     if (sample) {
         gst_sample_unref (sample);
     }
@@ -141,6 +109,7 @@ SinkPipeline::~SinkPipeline ()
 bool SinkPipeline::Create (void)
 {
     GstCaps* m_transCaps;
+    GstAppSinkCallbacks callbacks = { };
 
     // decode pipeline
     if (!(m_sinkPipeline = gst_pipeline_new ("decode-pipeline"))) {
@@ -209,18 +178,18 @@ bool SinkPipeline::Create (void)
         goto exit;
     }
 
-    // equals to gst_app_sink_set_emit_signals (GST_APP_SINK_CAST (m_appsink), true);
-    g_object_set (m_appsink, "emit-signals", TRUE, NULL);
+    // callbacks instead of "new-sample" signal, emit-signals stays FALSE
+    g_object_set (m_appsink, "emit-signals", FALSE, NULL);
+    // don't hold an extra reference of the last buffer, so it stays writable
+    g_object_set (m_appsink, "enable-last-sample", FALSE, NULL);
+    // the internal queue of appsink is unlimited by default
+    g_object_set (m_appsink, "max-buffers", m_config.max_buffers,
+        "drop", m_config.drop, "wait-on-eos", m_config.wait_on_eos, NULL);
 
-    // full definition of appsink callbacks
-    /*
-    GstAppSinkCallbacks callbacks = {cb_appsink_eos,
-                            cb_appsink_new_preroll, cb_appsink_new_sample};
+    // full definition of appsink callbacks is {eos, new_preroll, new_sample}
+    callbacks.new_sample = cb_appsink_new_sample;
     gst_app_sink_set_callbacks (GST_APP_SINK_CAST (m_appsink),
         &callbacks, reinterpret_cast<void*> (this), NULL);
-    */
-    g_signal_connect (m_appsink, "new-sample",
-        G_CALLBACK (cb_appsink_new_sample), reinterpret_cast<void*> (this));
 
     gst_bin_add_many (GST_BIN (m_sinkPipeline), m_appsink, NULL);
 
@@ -4,7 +4,7 @@
  * @Author: Ricardo Lu<shenglu1202@163.com>
  * @Date: 2021-08-28 09:57:13
  * @LastEditors: Ricardo Lu
- * @LastEditTime: 2021-09-01 12:41:48
+ * @LastEditTime: 2026-10-18 03:44:09
  */
 
 #include "appsrc.h"
@@ -31,8 +31,16 @@ GstFlowReturn cb_appsrc_need_data (
         // buffer = gst_buffer_new_wrapped(img->data, len);
         buffer = gst_buffer_new_allocate (NULL, len, NULL);
 
-        gst_buffer_map(buffer,&map,GST_MAP_READ);
-        memcpy(map.data, img->data, len);
+        gst_buffer_map(buffer,&map,GST_MAP_WRITE);
+        if (img->isContinuous()) {
+            memcpy(map.data, img->data, len);
+        } else {
+            // img is a view on a padded appsink frame, pack its rows
+            size_t row = img->cols * img->elemSize();
+            for (int i = 0; i < img->rows; i++) {
+                memcpy(map.data + i * row, img->ptr(i), row);
+            }
+        }
 
         GST_BUFFER_PTS (buffer) = sp->m_timestamp;
         GST_BUFFER_DURATION (buffer) = gst_util_uint64_scale_int (1, GST_SECOND, 25);
@@ -4,7 +4,7 @@
  * @Author: Ricardo Lu<shenglu1202@163.com>
  * @Date: 2021-08-28 09:17:16
  * @LastEditors: Ricardo Lu
- * @LastEditTime: 2021-08-30 13:34:17
+ * @LastEditTime: 2026-10-18 03:57:32
  */
 
 #include <gflags/gflags.h>
@@ -113,6 +113,9 @@ int main(int argc, char* argv[])
     m_sinkConfig.conv_format = "BGR";
     m_sinkConfig.conv_width = 1920;
     m_sinkConfig.conv_height = 1080;
+    m_sinkConfig.max_buffers = 2;
+    m_sinkConfig.drop = false;
+    m_sinkConfig.wait_on_eos = true;
 
     m_srcCofig.src_format = "BGR";
     m_srcCofig.src_width = 1920;
@@ -4,14 +4,20 @@
  * @Author: Ricardo Lu<shenglu1202@163.com>
  * @Date: 2021-08-29 08:51:01
  * @LastEditors: Ricardo Lu
- * @LastEditTime: 2022-07-16 13:52:32
+ * @LastEditTime: 2026-10-18 10:41:05
  */
 #pragma once
 
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <atomic>
 #include <memory>
 #include <list>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
 
 /** 
  * @brief Shared-buffer cache manager.
@@ -27,7 +33,7 @@ public:
      */    
     DoubleBufCache(std::function<bool()> notify_func =
             std::function<bool()>{nullptr}, std::string debug_info = "") noexcept : 
-            debug_info(debug_info), swap_ready(false) {
+            swap_ready(false), front_seq(0), debug_info(debug_info) {
         this->notify_func = notify_func;
     }
 
@@ -44,6 +50,8 @@ public:
     /**
      * @brief Put the latest buffer into cache queue to be processed.
      * Giving up control of previous front buffer.
+     * Threads blocked in fetch_wait()/fetch_wait_newer() are woken up, prefer
+     * them over notify_func which runs on the feeding(streaming) thread.
      * @Author: Ricardo Lu
      * @param[in] pending - The latest buffer.
      */
@@ -54,8 +62,10 @@ public:
 
         swap_mtx.lock();
         front_sp = pending;
-        swap_mtx.unlock();
+        front_seq++;
         swap_ready = true;
+        swap_mtx.unlock();
+        swap_cond.notify_all();
         if (notify_func) {
             notify_func();
         }
@@ -80,12 +90,62 @@ public:
         if (swap_ready) {
             swap_mtx.lock();
             back_sp = front_sp;
-            swap_mtx.unlock();
             swap_ready = false;
+            swap_mtx.unlock();
         }
         return back_sp;
     }
 
+    /**
+     * @brief Fetch the shared back buffer, sleep until a new buffer is fed if
+     * there is no new buffer since the last fetch.
+     * @Author: Ricardo Lu
+     * @param[in] timeout_ms - Max time to wait for a new buffer.
+     * @return Back buffer, nullptr if no new buffer is fed before timeout.
+     */
+    std::shared_ptr<T> fetch_wait(int timeout_ms) {
+        std::unique_lock<std::mutex> lock(swap_mtx);
+        if (!swap_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                [this] { return swap_ready.load(); })) {
+            return std::shared_ptr<T>();
+        }
+
+        back_sp = front_sp;
+        swap_ready = false;
+        return back_sp;
+    }
+
+    /**
+     * @brief Fetch the latest buffer once it is newer than a given sequence
+     * number. Each consumer keeps its own sequence number, so several
+     * consumers can wait on the same cache without stealing buffers.
+     * @Author: Ricardo Lu
+     * @param[in,out] seq - Sequence number of the last buffer the caller got,
+     * 0 at first, updated to the sequence number of the returned buffer.
+     * @param[in] timeout_ms - Max time to wait for a newer buffer.
+     * @return Latest buffer, nullptr if no newer buffer is fed before timeout.
+     */
+    std::shared_ptr<T> fetch_wait_newer(uint64_t& seq, int timeout_ms) {
+        std::unique_lock<std::mutex> lock(swap_mtx);
+        if (!swap_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                [this, seq] { return front_seq > seq; })) {
+            return std::shared_ptr<T>();
+        }
+
+        seq = front_seq;
+        return front_sp;
+    }
+
+    /**
+     * @brief Get the sequence number of the front buffer.
+     * @Author: Ricardo Lu
+     * @return Number of buffers fed so far.
+     */
+    uint64_t sequence() noexcept {
+        std::lock_guard<std::mutex> lock(swap_mtx);
+        return front_seq;
+    }
+
 private:
     //! Notification function will be called, if a new buffer fed.
     std::function<bool()> notify_func;
@@ -93,6 +153,10 @@ private:
     std::atomic<bool> swap_ready;
     //! Swapping mutex lock for thread safety.
     std::mutex swap_mtx;
+    //! Signaled when a new buffer is fed.
+    std::condition_variable swap_cond;
+    //! Sequence number of the front buffer, guarded by swap_mtx.
+    uint64_t front_seq;
     //! Front buffer for previous results saving.
     std::shared_ptr<T> front_sp;
     //! Back buffer to be fetched.
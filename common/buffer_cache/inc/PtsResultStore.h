@@ -0,0 +1,174 @@
+/*
+ * @Description: PTS Indexed Result Store Implement.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 13:05:52
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 13:05:52
+ */
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <map>
+#include <iterator>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief Inference results indexed by the PTS of the frame they belong to.
+ *
+ * The inference thread puts each result with the PTS of the sample it
+ * was computed on, the display branch looks up the result matching the
+ * PTS of the buffer being drawn. Lookups never wait, so the streaming
+ * thread is not blocked if inference lags behind.
+ */
+template<typename T>
+class PtsResultStore {
+public:
+    /**
+     * @brief constructor
+     * @Author: Ricardo Lu
+     * @param[in] capacity Max number of kept results, the oldest ones are evicted.
+     * @param[in] debug_info Name of the instantiated object for debug.
+     */
+    PtsResultStore(size_t capacity = 64, std::string debug_info = "") :
+            capacity(capacity ? capacity : 1), debug_info(debug_info) {
+    }
+
+    /**
+     * @brief deconstructor
+     * @Author: Ricardo Lu
+     */
+    ~PtsResultStore() noexcept {
+        if (!debug_info.empty() ) {
+            printf("PtsResultStore %s destroyed.", debug_info.c_str());
+        }
+    }
+
+    PtsResultStore(const PtsResultStore&) = delete;
+    PtsResultStore& operator=(const PtsResultStore&) = delete;
+
+    /**
+     * @brief Store the result of a frame, replacing any result with the same PTS.
+     * @Author: Ricardo Lu
+     * @param[in] pts - PTS of the inferred frame.
+     * @param[in] result - Inference result.
+     */
+    void put(uint64_t pts, std::shared_ptr<T> result) {
+        std::lock_guard<std::mutex> lock(store_mtx);
+        results[pts] = std::move(result);
+        while (results.size() > capacity) {
+            results.erase(results.begin());
+        }
+    }
+
+    /**
+     * @brief Find the result of exactly this frame.
+     * @Author: Ricardo Lu
+     * @param[in] pts - PTS of the frame to be drawn.
+     * @return Result, nullptr if the frame has not been inferred (yet).
+     */
+    std::shared_ptr<T> find_exact(uint64_t pts) {
+        std::lock_guard<std::mutex> lock(store_mtx);
+        auto it = results.find(pts);
+        return it == results.end() ? std::shared_ptr<T>() : it->second;
+    }
+
+    /**
+     * @brief Find the result whose PTS is the closest to the frame's, on
+     * either side.
+     * @Author: Ricardo Lu
+     * @param[in] pts - PTS of the frame to be drawn.
+     * @param[in] max_distance - Max distance between both PTS.
+     * @param[out] matched_pts - PTS of the returned result.
+     * @return Result, nullptr if there is none close enough.
+     */
+    std::shared_ptr<T> find_nearest(uint64_t pts, uint64_t max_distance,
+            uint64_t* matched_pts = nullptr) {
+        std::lock_guard<std::mutex> lock(store_mtx);
+        if (results.empty()) {
+            return std::shared_ptr<T>();
+        }
+
+        auto it = results.lower_bound(pts);
+        if (it == results.end() || (it != results.begin() &&
+                pts - std::prev(it)->first < it->first - pts)) {
+            --it;
+        }
+
+        uint64_t distance = it->first > pts ? it->first - pts : pts - it->first;
+        if (distance > max_distance) {
+            return std::shared_ptr<T>();
+        }
+
+        if (matched_pts) {
+            *matched_pts = it->first;
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief Find the most recent result not newer than the frame, e.g. to
+     * keep drawing the last boxes while inference runs at a lower rate.
+     * @Author: Ricardo Lu
+     * @param[in] pts - PTS of the frame to be drawn.
+     * @param[in] max_age - Max PTS difference, older results are considered stale.
+     * @param[out] matched_pts - PTS of the returned result.
+     * @return Result, nullptr if there is none recent enough.
+     */
+    std::shared_ptr<T> find_latest(uint64_t pts, uint64_t max_age,
+            uint64_t* matched_pts = nullptr) {
+        std::lock_guard<std::mutex> lock(store_mtx);
+        auto it = results.upper_bound(pts);
+        if (it == results.begin()) {
+            return std::shared_ptr<T>();
+        }
+
+        --it;
+        if (pts - it->first > max_age) {
+            return std::shared_ptr<T>();
+        }
+
+        if (matched_pts) {
+            *matched_pts = it->first;
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief Drop the results older than a PTS, e.g. once they have been drawn.
+     * @Author: Ricardo Lu
+     * @param[in] pts - Results with smaller PTS are dropped.
+     */
+    void evict_before(uint64_t pts) {
+        std::lock_guard<std::mutex> lock(store_mtx);
+        results.erase(results.begin(), results.lower_bound(pts));
+    }
+
+    /**
+     * @brief Drop all results, e.g. after a seek.
+     * @Author: Ricardo Lu
+     */
+    void clear() {
+        std::lock_guard<std::mutex> lock(store_mtx);
+        results.clear();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(store_mtx);
+        return results.size();
+    }
+
+private:
+    //! Guard of results.
+    std::mutex store_mtx;
+    //! Results ordered by PTS.
+    std::map<uint64_t, std::shared_ptr<T> > results;
+    //! Max number of kept results.
+    size_t capacity;
+public:
+    //! Indicate the name of an instantiated object for debug.
+    std::string debug_info;
+};
@@ -0,0 +1,248 @@
+/*
+ * @Description: Bounded Ring Buffer Cache Implement.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 10:03:17
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 10:03:17
+ */
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief What feed() does when the ring is full.
+ */
+typedef enum _OverflowPolicy {
+    DROP_OLDEST   = 0, /* evict the oldest cached buffer */
+    DROP_NEWEST   = 1, /* discard the buffer being fed */
+    BLOCK_TIMEOUT = 2  /* wait for a free slot, discard the fed buffer on timeout */
+}OverflowPolicy;
+
+/**
+ * @brief Bounded multi-producer/multi-consumer buffer cache.
+ *
+ * Unlike DoubleBufCache, which only keeps the latest buffer, every fed
+ * buffer is kept in FIFO order until a consumer pops it or the overflow
+ * policy drops it, and every drop is counted.
+ */
+template<typename T>
+class RingBufCache {
+public:
+    /**
+     * @brief constructor
+     * @Author: Ricardo Lu
+     * @param[in] capacity Max number of cached buffers.
+     * @param[in] policy Behavior of feed() on a full ring.
+     * @param[in] block_timeout_ms Max time feed() waits with BLOCK_TIMEOUT policy, negative to wait forever.
+     * @param[in] debug_info Name of the instantiated object for debug.
+     */
+    RingBufCache(size_t capacity, OverflowPolicy policy = OverflowPolicy::DROP_OLDEST,
+            int block_timeout_ms = 40, std::string debug_info = "") :
+            ring(capacity ? capacity : 1), head(0), count(0), stopped(false),
+            policy(policy), block_timeout_ms(block_timeout_ms),
+            fed_count(0), drop_oldest_count(0), drop_newest_count(0),
+            drop_timeout_count(0), debug_info(debug_info) {
+    }
+
+    /**
+     * @brief deconstructor
+     * @Author: Ricardo Lu
+     */
+    ~RingBufCache() noexcept {
+        stop();
+        if (!debug_info.empty() ) {
+            printf("RingBufCache %s destroyed.", debug_info.c_str());
+        }
+    }
+
+    RingBufCache(const RingBufCache&) = delete;
+    RingBufCache& operator=(const RingBufCache&) = delete;
+
+    /**
+     * @brief Append a buffer to the tail of the ring.
+     * @Author: Ricardo Lu
+     * @param[in] pending - The latest buffer.
+     * @return false if the pending buffer was dropped.
+     */
+    bool feed(std::shared_ptr<T> pending) {
+        if (nullptr == pending.get()) {
+            throw "ERROR: feed an empty buffer to RingBufCache";
+        }
+
+        std::unique_lock<std::mutex> lock(ring_mtx);
+        fed_count++;
+
+        if (count == ring.size()) {
+            if (policy == OverflowPolicy::DROP_NEWEST) {
+                drop_newest_count++;
+                return false;
+            } else if (policy == OverflowPolicy::DROP_OLDEST) {
+                ring[head].reset();
+                head = (head + 1) % ring.size();
+                count--;
+                drop_oldest_count++;
+            } else {
+                auto not_full = [this] { return stopped || count < ring.size(); };
+                if (block_timeout_ms < 0) {
+                    not_full_cond.wait(lock, not_full);
+                } else if (!not_full_cond.wait_for(lock,
+                        std::chrono::milliseconds(block_timeout_ms), not_full)) {
+                    drop_timeout_count++;
+                    return false;
+                }
+                if (stopped) {
+                    drop_newest_count++;
+                    return false;
+                }
+            }
+        }
+
+        ring[(head + count) % ring.size()] = std::move(pending);
+        count++;
+        lock.unlock();
+        not_empty_cond.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Pop the oldest buffer.
+     * @Author: Ricardo Lu
+     * @param[out] out - The oldest buffer.
+     * @param[in] timeout_ms - Max time to wait for a buffer, 0 to return at once, negative to wait forever.
+     * @return false if the ring is still empty.
+     */
+    bool pop(std::shared_ptr<T>& out, int timeout_ms = 0) {
+        std::unique_lock<std::mutex> lock(ring_mtx);
+        if (!wait_not_empty(lock, timeout_ms)) {
+            return false;
+        }
+
+        out = take_front();
+        lock.unlock();
+        not_full_cond.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Pop up to n of the oldest buffers at once, e.g. for batched inference.
+     * @Author: Ricardo Lu
+     * @param[out] out - Popped buffers are appended to it in FIFO order.
+     * @param[in] n - Max number of buffers to pop.
+     * @param[in] timeout_ms - Max time to wait for the first buffer, 0 to return at once, negative to wait forever.
+     * @return Number of popped buffers.
+     */
+    size_t pop_n(std::vector<std::shared_ptr<T> >& out, size_t n, int timeout_ms = 0) {
+        std::unique_lock<std::mutex> lock(ring_mtx);
+        if (n == 0 || !wait_not_empty(lock, timeout_ms)) {
+            return 0;
+        }
+
+        size_t popped = n < count ? n : count;
+        out.reserve(out.size() + popped);
+        for (size_t i = 0; i < popped; i++) {
+            out.push_back(take_front());
+        }
+        lock.unlock();
+        not_full_cond.notify_all();
+        return popped;
+    }
+
+    /**
+     * @brief Wake up and reject all blocked feeders and consumers, e.g. before
+     * the pipeline is destroyed. Cached buffers can still be popped.
+     * @Author: Ricardo Lu
+     */
+    void stop() noexcept {
+        {
+            std::lock_guard<std::mutex> lock(ring_mtx);
+            stopped = true;
+        }
+        not_empty_cond.notify_all();
+        not_full_cond.notify_all();
+    }
+
+    /**
+     * @brief Drop all cached buffers.
+     * @Author: Ricardo Lu
+     */
+    void clear() {
+        {
+            std::lock_guard<std::mutex> lock(ring_mtx);
+            while (count) {
+                take_front();
+            }
+        }
+        not_full_cond.notify_all();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(ring_mtx);
+        return count;
+    }
+
+    size_t capacity() const noexcept {
+        return ring.size();
+    }
+
+    //! Number of buffers passed to feed(), dropped or not.
+    uint64_t fed() const noexcept { return fed_count.load(); }
+    //! Number of cached buffers evicted by DROP_OLDEST.
+    uint64_t dropped_oldest() const noexcept { return drop_oldest_count.load(); }
+    //! Number of fed buffers discarded by DROP_NEWEST or after stop().
+    uint64_t dropped_newest() const noexcept { return drop_newest_count.load(); }
+    //! Number of fed buffers discarded after the BLOCK_TIMEOUT wait expired.
+    uint64_t dropped_timeout() const noexcept { return drop_timeout_count.load(); }
+    //! Total number of dropped buffers.
+    uint64_t dropped() const noexcept {
+        return dropped_oldest() + dropped_newest() + dropped_timeout();
+    }
+
+private:
+    bool wait_not_empty(std::unique_lock<std::mutex>& lock, int timeout_ms) {
+        auto not_empty = [this] { return stopped || count > 0; };
+        if (timeout_ms < 0) {
+            not_empty_cond.wait(lock, not_empty);
+        } else if (timeout_ms > 0) {
+            not_empty_cond.wait_for(lock,
+                std::chrono::milliseconds(timeout_ms), not_empty);
+        }
+        return count > 0;
+    }
+
+    std::shared_ptr<T> take_front() {
+        std::shared_ptr<T> sp = std::move(ring[head]);
+        head = (head + 1) % ring.size();
+        count--;
+        return sp;
+    }
+
+    //! Guard of the ring, head and count.
+    std::mutex ring_mtx;
+    std::condition_variable not_empty_cond;
+    std::condition_variable not_full_cond;
+    //! Fixed-size storage, buffers live in [head, head + count).
+    std::vector<std::shared_ptr<T> > ring;
+    size_t head;
+    size_t count;
+    bool stopped;
+
+    OverflowPolicy policy;
+    int            block_timeout_ms;
+
+    std::atomic<uint64_t> fed_count;
+    std::atomic<uint64_t> drop_oldest_count;
+    std::atomic<uint64_t> drop_newest_count;
+    std::atomic<uint64_t> drop_timeout_count;
+public:
+    //! Indicate the name of an instantiated object for debug.
+    std::string debug_info;
+};
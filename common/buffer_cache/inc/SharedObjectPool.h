@@ -0,0 +1,317 @@
+/*
+ * @Description: Fixed Capacity Shared Object Pool Implement.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 15:10:44
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 04:45:22
+ */
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief Fixed number of equally sized memory blocks, shared by a
+ * SharedObjectPool and the allocators stored in the control blocks of the
+ * objects it made, so it lives until the last pooled object is released.
+ */
+class FixedBlockPool {
+public:
+    FixedBlockPool(size_t capacity) :
+            capacity(capacity), block_size(0), storage(nullptr),
+            hit_count(0), miss_count(0) {
+    }
+
+    ~FixedBlockPool() noexcept {
+        if (storage) {
+            ::operator delete(storage);
+        }
+    }
+
+    FixedBlockPool(const FixedBlockPool&) = delete;
+    FixedBlockPool& operator=(const FixedBlockPool&) = delete;
+
+    /**
+     * @brief Get a block from the pool, fall back to the heap if the pool is
+     * exhausted or the size doesn't match the pool's block size.
+     * @Author: Ricardo Lu
+     * @param[in] size - Block size, the first request decides the block size of the pool.
+     */
+    void* allocate(size_t size) {
+        {
+            std::lock_guard<std::mutex> lock(pool_mtx);
+            if (!storage && capacity) {
+                block_size = (size + alignof(std::max_align_t) - 1) &
+                    ~(alignof(std::max_align_t) - 1);
+                storage = static_cast<char*>(::operator new(block_size * capacity));
+                free_list.reserve(capacity);
+                for (size_t i = capacity; i > 0; i--) {
+                    free_list.push_back(storage + (i - 1) * block_size);
+                }
+            }
+
+            if (size <= block_size && !free_list.empty()) {
+                void* block = free_list.back();
+                free_list.pop_back();
+                hit_count++;
+                return block;
+            }
+        }
+
+        miss_count++;
+        return ::operator new(size);
+    }
+
+    void deallocate(void* block) noexcept {
+        char* p = static_cast<char*>(block);
+        if (storage && p >= storage && p < storage + block_size * capacity) {
+            std::lock_guard<std::mutex> lock(pool_mtx);
+            free_list.push_back(block);
+            return;
+        }
+
+        ::operator delete(block);
+    }
+
+    size_t available() {
+        std::lock_guard<std::mutex> lock(pool_mtx);
+        return storage ? free_list.size() : capacity;
+    }
+
+    //! Max number of pooled blocks.
+    const size_t capacity;
+    //! Number of allocations served by the pool.
+    uint64_t hits() const noexcept { return hit_count.load(); }
+    //! Number of allocations that fell back to the heap.
+    uint64_t misses() const noexcept { return miss_count.load(); }
+
+private:
+    std::mutex          pool_mtx;
+    size_t              block_size;
+    char*               storage;
+    std::vector<void*>  free_list;
+    std::atomic<uint64_t> hit_count;
+    std::atomic<uint64_t> miss_count;
+};
+
+/**
+ * @brief std::allocate_shared() allocator drawing from a FixedBlockPool.
+ */
+template<typename T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+
+    explicit PoolAllocator(std::shared_ptr<FixedBlockPool> pool) noexcept :
+            pool(std::move(pool)) {
+    }
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept : pool(other.pool) {
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(pool->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        pool->deallocate(p);
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U>& other) const noexcept {
+        return pool == other.pool;
+    }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U>& other) const noexcept {
+        return pool != other.pool;
+    }
+
+    std::shared_ptr<FixedBlockPool> pool;
+};
+
+/**
+ * @brief Make std::shared_ptr<T> handles whose object and control block share
+ * one block from a fixed-capacity pool, so handing frames and results
+ * between threads does no heap allocation in steady state.
+ */
+template<typename T>
+class SharedObjectPool {
+public:
+    /**
+     * @brief constructor
+     * @Author: Ricardo Lu
+     * @param[in] capacity Max number of alive pooled objects, more objects are heap allocated.
+     * @param[in] debug_info Name of the instantiated object for debug.
+     */
+    SharedObjectPool(size_t capacity, std::string debug_info = "") :
+            pool(std::make_shared<FixedBlockPool>(capacity)), debug_info(debug_info) {
+    }
+
+    /**
+     * @brief deconstructor, objects still alive keep the memory pool alive.
+     * @Author: Ricardo Lu
+     */
+    ~SharedObjectPool() noexcept {
+        if (!debug_info.empty() ) {
+            printf("SharedObjectPool %s destroyed, hit: %lu, miss: %lu.\n",
+                debug_info.c_str(), (unsigned long)hits(), (unsigned long)misses());
+        }
+    }
+
+    SharedObjectPool(const SharedObjectPool&) = delete;
+    SharedObjectPool& operator=(const SharedObjectPool&) = delete;
+
+    /**
+     * @brief Construct an object in a pooled block.
+     * @Author: Ricardo Lu
+     * @param[in] args - Arguments forwarded to the constructor of T.
+     */
+    template<typename... Args>
+    std::shared_ptr<T> make(Args&&... args) {
+        return std::allocate_shared<T>(PoolAllocator<T>(pool),
+            std::forward<Args>(args)...);
+    }
+
+    size_t capacity() const noexcept { return pool->capacity; }
+    size_t available() { return pool->available(); }
+    //! Number of objects made in a pooled block.
+    uint64_t hits() const noexcept { return pool->hits(); }
+    //! Number of objects made on the heap because the pool was exhausted.
+    uint64_t misses() const noexcept { return pool->misses(); }
+
+private:
+    std::shared_ptr<FixedBlockPool> pool;
+public:
+    //! Indicate the name of an instantiated object for debug.
+    std::string debug_info;
+};
+
+/**
+ * @brief Recycle objects whose own storage is worth keeping, such as a
+ * std::vector and its capacity. Released objects are reset and kept for the
+ * next acquire(), the control blocks come from a FixedBlockPool, so once
+ * warmed up neither the handle nor the contents allocate.
+ */
+template<typename T>
+class RecycledObjectPool {
+public:
+    typedef std::function<void(T&)> ResetFunc;
+
+    /**
+     * @brief constructor
+     * @Author: Ricardo Lu
+     * @param[in] capacity Max number of idle objects kept, more are deleted once released.
+     * @param[in] reset Called on every released object, clear() by default.
+     * @param[in] debug_info Name of the instantiated object for debug.
+     */
+    RecycledObjectPool(size_t capacity, ResetFunc reset = [](T& obj) { obj.clear(); },
+            std::string debug_info = "") :
+            store(std::make_shared<Store>(capacity, std::move(reset))),
+            blocks(std::make_shared<FixedBlockPool>(capacity)), debug_info(debug_info) {
+    }
+
+    /**
+     * @brief deconstructor, objects still alive are deleted once released.
+     * @Author: Ricardo Lu
+     */
+    ~RecycledObjectPool() noexcept {
+        if (!debug_info.empty() ) {
+            printf("RecycledObjectPool %s destroyed, hit: %lu, miss: %lu.\n",
+                debug_info.c_str(), (unsigned long)hits(), (unsigned long)misses());
+        }
+    }
+
+    RecycledObjectPool(const RecycledObjectPool&) = delete;
+    RecycledObjectPool& operator=(const RecycledObjectPool&) = delete;
+
+    /**
+     * @brief Get an idle object, or construct one if none is left.
+     * @Author: Ricardo Lu
+     * @param[in] args - Arguments forwarded to the constructor of T, unused by a recycled object.
+     */
+    template<typename... Args>
+    std::shared_ptr<T> acquire(Args&&... args) {
+        T* obj = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(store->mtx);
+            if (!store->idle.empty()) {
+                obj = store->idle.back();
+                store->idle.pop_back();
+            }
+        }
+
+        if (obj) {
+            store->hit_count++;
+        } else {
+            store->miss_count++;
+            obj = new T(std::forward<Args>(args)...);
+        }
+
+        return std::shared_ptr<T>(obj, Recycler{ store }, PoolAllocator<T>(blocks));
+    }
+
+    size_t capacity() const noexcept { return store->capacity; }
+    size_t idle() {
+        std::lock_guard<std::mutex> lock(store->mtx);
+        return store->idle.size();
+    }
+    //! Number of objects recycled.
+    uint64_t hits() const noexcept { return store->hit_count.load(); }
+    //! Number of objects constructed because none was idle.
+    uint64_t misses() const noexcept { return store->miss_count.load(); }
+
+private:
+    // outlives the pool while objects are alive, they come back to it
+    struct Store {
+        Store(size_t capacity, ResetFunc reset) :
+                capacity(capacity), reset(std::move(reset)), hit_count(0), miss_count(0) {
+            idle.reserve(capacity);
+        }
+
+        ~Store() noexcept {
+            for (T* obj : idle) {
+                delete obj;
+            }
+        }
+
+        const size_t            capacity;
+        const ResetFunc         reset;
+        std::mutex              mtx;
+        std::vector<T*>         idle;
+        std::atomic<uint64_t>   hit_count;
+        std::atomic<uint64_t>   miss_count;
+    };
+
+    struct Recycler {
+        std::shared_ptr<Store> store;
+
+        void operator()(T* obj) const noexcept {
+            store->reset(*obj);
+            {
+                std::lock_guard<std::mutex> lock(store->mtx);
+                if (store->idle.size() < store->capacity) {
+                    store->idle.push_back(obj);
+                    return;
+                }
+            }
+            delete obj;
+        }
+    };
+
+    std::shared_ptr<Store> store;
+    std::shared_ptr<FixedBlockPool> blocks;
+public:
+    //! Indicate the name of an instantiated object for debug.
+    std::string debug_info;
+};
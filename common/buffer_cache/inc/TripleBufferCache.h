@@ -0,0 +1,179 @@
+/*
+ * @Description: Lock-free Triple Buffer Cache Implement.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 09:12:40
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 09:12:40
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+
+/**
+ * @brief Lock-free shared-buffer cache manager, a drop-in variant of
+ * DoubleBufCache for one feeding thread and one fetching thread.
+ *
+ * Three slots rotate between the producer (write slot), the consumer
+ * (read slot) and a shared middle slot. feed() and fetch() only exchange
+ * the middle slot index atomically, so the streaming thread never waits
+ * on the inference thread and no shared_ptr is copied under a lock.
+ */
+template<typename T>
+class TripleBufCache {
+public:
+    /**
+     * @brief constructor
+     * @Author: Ricardo Lu
+     * @param[in] notify_func When a new buffer is fed, it triggers the function handle.
+     * @param[in] debug_info Name of the instantiated object for debug.
+     */
+    TripleBufCache(std::function<bool()> notify_func =
+            std::function<bool()>{nullptr}, std::string debug_info = "") noexcept :
+            middle_idx(1), write_idx(0), read_idx(2), last_idx(2),
+            feed_seq(0), read_seq(0), debug_info(debug_info) {
+        this->notify_func = notify_func;
+        for (int i = 0; i < 3; i++) {
+            slots[i].seq = 0;
+        }
+    }
+
+    /**
+     * @brief deconstructor
+     * @Author: Ricardo Lu
+     */
+    ~TripleBufCache() noexcept {
+        if (!debug_info.empty() ) {
+            printf("TripleBufCache %s destroyed.", debug_info.c_str());
+        }
+    }
+
+    TripleBufCache(const TripleBufCache&) = delete;
+    TripleBufCache& operator=(const TripleBufCache&) = delete;
+
+    /**
+     * @brief Publish the latest buffer to the consumer. The buffer published
+     * before it is dropped if it has not been fetched yet.
+     * Must only be called from one thread.
+     * @Author: Ricardo Lu
+     * @param[in] pending - The latest buffer.
+     */
+    void feed(std::shared_ptr<T> pending) {
+        if (nullptr == pending.get()) {
+            throw "ERROR: feed an empty buffer to TripleBufCache";
+        }
+
+        Slot& slot = slots[write_idx];
+        slot.sp  = std::move(pending);
+        slot.seq = feed_seq.load(std::memory_order_relaxed) + 1;
+        feed_seq.store(slot.seq, std::memory_order_release);
+
+        last_idx  = write_idx;
+        write_idx = middle_idx.exchange(write_idx | DIRTY_BIT,
+            std::memory_order_acq_rel) & INDEX_MASK;
+        // release the stale buffer as early as possible, it could belong
+        // to an upstream buffer pool
+        slots[write_idx].sp.reset();
+
+        if (notify_func) {
+            notify_func();
+        }
+        return;
+    }
+
+    /**
+     * @brief Get the latest fed buffer.
+     * Only safe to be called from the feeding thread.
+     * @Author: Ricardo Lu
+     * @return Front buffer.
+     */
+    std::shared_ptr<T> front() noexcept {
+        return slots[last_idx].sp;
+    }
+
+    /**
+     * @brief Fetch the latest published buffer, or the previous one again
+     * if nothing new has been fed since the last fetch.
+     * Must only be called from one thread.
+     * @Author: Ricardo Lu
+     * @return Back buffer.
+     */
+    std::shared_ptr<T> fetch() noexcept {
+        swap_if_dirty();
+        read_seq = slots[read_idx].seq;
+        return slots[read_idx].sp;
+    }
+
+    /**
+     * @brief Fetch the latest published buffer only if it is newer than the
+     * one returned by the previous fetch.
+     * @Author: Ricardo Lu
+     * @param[out] out - Latest buffer, untouched if there is no new buffer.
+     * @param[out] seq - Sequence number of the buffer, starting from 1.
+     * @return true if a new buffer has been fed since the last fetch.
+     */
+    bool fetch_if_new(std::shared_ptr<T>& out, uint64_t* seq = nullptr) noexcept {
+        swap_if_dirty();
+
+        const Slot& slot = slots[read_idx];
+        if (slot.seq == 0 || slot.seq == read_seq) {
+            return false;
+        }
+
+        read_seq = slot.seq;
+        out = slot.sp;
+        if (seq) {
+            *seq = slot.seq;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Number of buffers fed so far.
+     * @Author: Ricardo Lu
+     */
+    uint64_t sequence() const noexcept {
+        return feed_seq.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Slot {
+        std::shared_ptr<T> sp;
+        uint64_t           seq;
+    };
+
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t DIRTY_BIT  = 0x4;
+
+    void swap_if_dirty() noexcept {
+        if (middle_idx.load(std::memory_order_relaxed) & DIRTY_BIT) {
+            read_idx = middle_idx.exchange(read_idx,
+                std::memory_order_acq_rel) & INDEX_MASK;
+        }
+    }
+
+    //! Notification function will be called, if a new buffer fed.
+    std::function<bool()> notify_func;
+    //! Buffer slots, each one owned by the producer, the consumer or neither.
+    Slot slots[3];
+    //! Index of the shared middle slot, with DIRTY_BIT set if it is unread.
+    std::atomic<uint8_t> middle_idx;
+    //! Slot owned by the feeding thread.
+    uint8_t write_idx;
+    //! Slot owned by the fetching thread.
+    uint8_t read_idx;
+    //! Slot most recently published by the feeding thread.
+    uint8_t last_idx;
+    //! Sequence number of the latest fed buffer.
+    std::atomic<uint64_t> feed_seq;
+    //! Sequence number of the buffer returned by the last fetch_if_new().
+    uint64_t read_seq;
+public:
+    //! Indicate the name of an instantiated object for debug.
+    std::string debug_info;
+};
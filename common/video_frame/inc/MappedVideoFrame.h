@@ -0,0 +1,128 @@
+/*
+ * @Description: Zero-copy cv::Mat view over a mapped GstSample.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 14:02:26
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 14:02:26
+ */
+#pragma once
+
+#include <memory>
+
+#include <opencv2/opencv.hpp>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+/**
+ * @brief Keep a GstSample referenced and its video frame mapped for as long
+ * as a cv::Mat view on the frame data is alive.
+ *
+ * Supported formats: BGR, RGB, RGBA/BGRA/RGBx/BGRx, GRAY8 and NV12. NV12 is
+ * viewed as a single (height * 3 / 2) x width CV_8UC1 matrix as expected by
+ * cv::cvtColor(COLOR_YUV2BGR_NV12), which needs the UV plane to directly
+ * follow the Y plane with the same stride.
+ */
+class MappedVideoFrame {
+public:
+    /**
+     * @brief Map a sample and wrap its pixels into a cv::Mat without copy.
+     * @Author: Ricardo Lu
+     * @param[in] sample - Sample pulled from appsink, a new reference is taken.
+     * @param[in] flags - GST_MAP_READ, or GST_MAP_READWRITE to draw on the frame.
+     * @return cv::Mat view, row step follows the real stride of the frame,
+     * nullptr if the sample can't be mapped with flags or the format is not supported.
+     */
+    static std::shared_ptr<cv::Mat> Map(GstSample* sample,
+        GstMapFlags flags = GST_MAP_READ)
+    {
+        GstCaps* caps = gst_sample_get_caps(sample);
+        GstBuffer* buffer = gst_sample_get_buffer(sample);
+        if (!caps || !buffer) {
+            return std::shared_ptr<cv::Mat>();
+        }
+
+        // writing needs the only reference of the buffer, e.g. appsink
+        // with enable-last-sample=false
+        if ((flags & GST_MAP_WRITE) && !gst_buffer_is_writable(buffer)) {
+            return std::shared_ptr<cv::Mat>();
+        }
+
+        std::shared_ptr<MappedVideoFrame> frame(new MappedVideoFrame());
+        if (!gst_video_info_from_caps(&frame->m_info, caps)) {
+            return std::shared_ptr<cv::Mat>();
+        }
+
+        if (!gst_video_frame_map(&frame->m_frame, &frame->m_info, buffer,
+                (GstMapFlags)(flags | GST_VIDEO_FRAME_MAP_FLAG_NO_REF))) {
+            return std::shared_ptr<cv::Mat>();
+        }
+        frame->m_sample = gst_sample_ref(sample);
+
+        if (!frame->Wrap()) {
+            return std::shared_ptr<cv::Mat>();
+        }
+
+        // aliasing constructor: the cv::Mat shares the lifetime of the mapping
+        return std::shared_ptr<cv::Mat>(frame, &frame->m_mat);
+    }
+
+    ~MappedVideoFrame()
+    {
+        m_mat.release();
+        if (m_sample) {
+            gst_video_frame_unmap(&m_frame);
+            gst_sample_unref(m_sample);
+            m_sample = nullptr;
+        }
+    }
+
+    MappedVideoFrame(const MappedVideoFrame&) = delete;
+    MappedVideoFrame& operator=(const MappedVideoFrame&) = delete;
+
+private:
+    MappedVideoFrame() : m_sample(nullptr)
+    {
+        gst_video_info_init(&m_info);
+    }
+
+    bool Wrap()
+    {
+        int width  = GST_VIDEO_FRAME_WIDTH(&m_frame);
+        int height = GST_VIDEO_FRAME_HEIGHT(&m_frame);
+        guint8* data = (guint8*)GST_VIDEO_FRAME_PLANE_DATA(&m_frame, 0);
+        size_t stride = GST_VIDEO_FRAME_PLANE_STRIDE(&m_frame, 0);
+
+        switch (GST_VIDEO_FRAME_FORMAT(&m_frame)) {
+            case GST_VIDEO_FORMAT_BGR:
+            case GST_VIDEO_FORMAT_RGB:
+                m_mat = cv::Mat(height, width, CV_8UC3, data, stride);
+                return true;
+            case GST_VIDEO_FORMAT_RGBA:
+            case GST_VIDEO_FORMAT_BGRA:
+            case GST_VIDEO_FORMAT_RGBx:
+            case GST_VIDEO_FORMAT_BGRx:
+                m_mat = cv::Mat(height, width, CV_8UC4, data, stride);
+                return true;
+            case GST_VIDEO_FORMAT_GRAY8:
+                m_mat = cv::Mat(height, width, CV_8UC1, data, stride);
+                return true;
+            case GST_VIDEO_FORMAT_NV12:
+                if ((guint8*)GST_VIDEO_FRAME_PLANE_DATA(&m_frame, 1) !=
+                        data + stride * height ||
+                    (size_t)GST_VIDEO_FRAME_PLANE_STRIDE(&m_frame, 1) != stride) {
+                    // planes are not contiguous, a single cv::Mat can't view them
+                    return false;
+                }
+                m_mat = cv::Mat(height * 3 / 2, width, CV_8UC1, data, stride);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    GstSample*    m_sample;
+    GstVideoInfo  m_info;
+    GstVideoFrame m_frame;
+    cv::Mat       m_mat;
+};
@@ -0,0 +1,318 @@
+/*
+ * @Description: Scale one video frame into several outputs in a single pass.
+ * @version: 1.0
+ * @Author: Ricardo Lu<shenglu1202@163.com>
+ * @Date: 2026-10-18 19:40:18
+ * @LastEditors: Ricardo Lu
+ * @LastEditTime: 2026-10-18 19:40:18
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <gst/video/video.h>
+
+/* one output of MultiScaler */
+typedef struct _ScaleOutputConfig {
+    std::string     name;
+    int             width;
+    int             height;
+    GstVideoFormat  format;         /* RGB, BGR, RGBA, BGRA, RGBx, BGRx or GRAY8 */
+    bool            letterbox;      /* keep the aspect ratio, pad the rest */
+    uint8_t         pad_value;
+}ScaleOutputConfig;
+
+/* scaled frame, source position = (output position - pad) / scale */
+typedef struct _ScaledFrame {
+    cv::Mat         image;          /* shared with the scaler until released */
+    double          scale_x;
+    double          scale_y;
+    int             pad_x;
+    int             pad_y;
+}ScaledFrame;
+
+/**
+ * @brief Bilinear scaling and channel reordering of one packed 8-bit frame
+ * into several outputs of their own size, format and letterbox.
+ *
+ * Source rows are visited once, top to bottom, and every output that needs
+ * a row resamples it horizontally while it is hot in cache, so the source
+ * is read from memory once however many outputs there are. An output image
+ * is reused by the next frame unless the receiver still holds it.
+ */
+class MultiScaler {
+public:
+    explicit MultiScaler(const std::vector<ScaleOutputConfig>& configs) :
+        m_outputs(configs.size()),
+        m_srcWidth(0),
+        m_srcHeight(0),
+        m_srcFormat(GST_VIDEO_FORMAT_UNKNOWN) {
+        for (size_t i = 0; i < configs.size(); i++) {
+            m_outputs[i].config = configs[i];
+            m_outputs[i].channels = Channels(configs[i].format);
+        }
+    }
+
+    size_t Size() const {
+        return m_outputs.size();
+    }
+
+    const ScaleOutputConfig& Config(size_t index) const {
+        return m_outputs[index].config;
+    }
+
+    static bool Supported(GstVideoFormat format) {
+        return Channels(format) > 0;
+    }
+
+    /**
+     * @brief Scale the frame into every output.
+     * @Author: Ricardo Lu
+     * @param[in] src - packed 8-bit pixels, row step may be larger than the row.
+     * @param[in] format - pixel format of src.
+     * @param[out] frames - one per output, in the order of the configs.
+     * @return false if a format isn't supported or src doesn't match it.
+     */
+    bool Process(const cv::Mat& src, GstVideoFormat format, std::vector<ScaledFrame>& frames) {
+        int src_channels = Channels(format);
+
+        if (src.empty() || src.depth() != CV_8U || src_channels != src.channels()) {
+            return false;
+        }
+
+        if (src.cols != m_srcWidth || src.rows != m_srcHeight || format != m_srcFormat) {
+            m_srcWidth = src.cols;
+            m_srcHeight = src.rows;
+            m_srcFormat = format;
+            for (Output& output : m_outputs) {
+                if (output.channels <= 0 || !Prepare(output, format)) {
+                    m_srcWidth = m_srcHeight = 0;
+                    return false;
+                }
+            }
+        }
+
+        // the last frames handed out are no longer held by the caller
+        for (ScaledFrame& frame : frames) {
+            frame.image.release();
+        }
+
+        for (Output& output : m_outputs) {
+            Acquire(output);
+            output.next_row = 0;
+        }
+
+        for (int sy = 0; sy < src.rows; sy++) {
+            const uint8_t* row = src.ptr<uint8_t>(sy);
+
+            for (Output& output : m_outputs) {
+                if (!output.needed[sy]) {
+                    continue;
+                }
+
+                // a row is only needed by the two output rows around it
+                Horizontal(output, row, src_channels, output.rows[sy & 1]);
+                while (output.next_row < output.content_height &&
+                    output.y1[output.next_row] <= sy) {
+                    Vertical(output, output.next_row);
+                    output.next_row++;
+                }
+            }
+        }
+
+        frames.resize(m_outputs.size());
+        for (size_t i = 0; i < m_outputs.size(); i++) {
+            Output& output = m_outputs[i];
+            frames[i].image = output.image;
+            frames[i].scale_x = (double)output.content_width / m_srcWidth;
+            frames[i].scale_y = (double)output.content_height / m_srcHeight;
+            frames[i].pad_x = output.pad_x;
+            frames[i].pad_y = output.pad_y;
+        }
+
+        return true;
+    }
+
+private:
+    static const int SHIFT = 8;
+    static const int ONE = 1 << SHIFT;
+
+    struct Output {
+        ScaleOutputConfig       config;
+        int                     channels;       /* of the output image */
+        int                     work_channels;  /* per pixel of the resampled rows */
+        int                     content_width;  /* scaled area inside the padding */
+        int                     content_height;
+        int                     pad_x;
+        int                     pad_y;
+        int                     map[4];         /* source channel of each output channel, -1 for 255 */
+        bool                    gray;           /* luma of the source */
+        int                     luma[3];        /* source channel of R, G and B */
+        std::vector<int>        x0, x1, wx;     /* per output column */
+        std::vector<int>        y0, y1, wy;     /* per output row */
+        std::vector<char>       needed;         /* per source row */
+        std::vector<uint16_t>   rows[2];        /* resampled source rows, by parity */
+        int                     next_row;
+        cv::Mat                 image;
+    };
+
+    static int Channels(GstVideoFormat format) {
+        switch (format) {
+            case GST_VIDEO_FORMAT_RGB:
+            case GST_VIDEO_FORMAT_BGR:
+                return 3;
+            case GST_VIDEO_FORMAT_RGBA:
+            case GST_VIDEO_FORMAT_BGRA:
+            case GST_VIDEO_FORMAT_RGBx:
+            case GST_VIDEO_FORMAT_BGRx:
+                return 4;
+            case GST_VIDEO_FORMAT_GRAY8:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+
+    // index of R, G and B, all 0 for GRAY8
+    static void ColorIndex(GstVideoFormat format, int& r, int& g, int& b) {
+        switch (format) {
+            case GST_VIDEO_FORMAT_BGR:
+            case GST_VIDEO_FORMAT_BGRA:
+            case GST_VIDEO_FORMAT_BGRx:
+                r = 2, g = 1, b = 0;
+                break;
+            case GST_VIDEO_FORMAT_GRAY8:
+                r = g = b = 0;
+                break;
+            default:
+                r = 0, g = 1, b = 2;
+                break;
+        }
+    }
+
+    // source index and weight of the right/lower neighbour of each output sample
+    static void Coordinates(int src, int dst, std::vector<int>& i0,
+        std::vector<int>& i1, std::vector<int>& w) {
+        i0.resize(dst);
+        i1.resize(dst);
+        w.resize(dst);
+
+        for (int d = 0; d < dst; d++) {
+            double f = (d + 0.5) * src / dst - 0.5;
+            f = std::min(std::max(f, 0.0), (double)(src - 1));
+            i0[d] = (int)f;
+            i1[d] = std::min(i0[d] + 1, src - 1);
+            w[d] = (int)((f - i0[d]) * ONE + 0.5);
+        }
+    }
+
+    bool Prepare(Output& output, GstVideoFormat src_format) {
+        const ScaleOutputConfig& config = output.config;
+        int r, g, b, dr, dg, db;
+
+        if (config.width <= 0 || config.height <= 0) {
+            return false;
+        }
+
+        output.content_width = config.width;
+        output.content_height = config.height;
+        if (config.letterbox) {
+            double scale = std::min((double)config.width / m_srcWidth,
+                (double)config.height / m_srcHeight);
+            output.content_width = std::max(1, std::min(config.width, (int)(m_srcWidth * scale + 0.5)));
+            output.content_height = std::max(1, std::min(config.height, (int)(m_srcHeight * scale + 0.5)));
+        }
+        output.pad_x = (config.width - output.content_width) / 2;
+        output.pad_y = (config.height - output.content_height) / 2;
+
+        ColorIndex(src_format, r, g, b);
+        ColorIndex(config.format, dr, dg, db);
+        output.gray = config.format == GST_VIDEO_FORMAT_GRAY8 && src_format != GST_VIDEO_FORMAT_GRAY8;
+        output.luma[0] = r, output.luma[1] = g, output.luma[2] = b;
+        output.work_channels = output.gray ? 1 : std::min(output.channels, 3);
+        output.map[0] = output.map[1] = output.map[2] = output.map[3] = -1;
+        if (config.format == GST_VIDEO_FORMAT_GRAY8) {
+            output.map[0] = 0;
+        } else {
+            output.map[dr] = r;
+            output.map[dg] = g;
+            output.map[db] = b;
+        }
+
+        Coordinates(m_srcWidth, output.content_width, output.x0, output.x1, output.wx);
+        Coordinates(m_srcHeight, output.content_height, output.y0, output.y1, output.wy);
+
+        output.needed.assign(m_srcHeight, 0);
+        for (int dy = 0; dy < output.content_height; dy++) {
+            output.needed[output.y0[dy]] = output.needed[output.y1[dy]] = 1;
+        }
+
+        output.rows[0].assign((size_t)output.content_width * output.work_channels, 0);
+        output.rows[1].assign((size_t)output.content_width * output.work_channels, 0);
+
+        // the geometry changed, so does the padding
+        output.image.release();
+        return true;
+    }
+
+    // the padding is never written again, so it's only filled on allocation
+    void Acquire(Output& output) {
+        const ScaleOutputConfig& config = output.config;
+
+        if (!output.image.empty() && output.image.u && output.image.u->refcount <= 1) {
+            return;
+        }
+
+        output.image = cv::Mat(config.height, config.width, CV_8UC(output.channels),
+            cv::Scalar(config.pad_value, config.pad_value, config.pad_value, 255));
+    }
+
+    static void Horizontal(const Output& output, const uint8_t* row, int src_channels,
+        std::vector<uint16_t>& dst) {
+        const int channels = output.work_channels;
+        uint16_t* out = dst.data();
+
+        for (int dx = 0; dx < output.content_width; dx++, out += channels) {
+            const uint8_t* p0 = row + output.x0[dx] * src_channels;
+            const uint8_t* p1 = row + output.x1[dx] * src_channels;
+            const int w1 = output.wx[dx], w0 = ONE - w1;
+
+            if (output.gray) {
+                const int r = output.luma[0], g = output.luma[1], b = output.luma[2];
+                int l0 = (77 * p0[r] + 150 * p0[g] + 29 * p0[b]) >> 8;
+                int l1 = (77 * p1[r] + 150 * p1[g] + 29 * p1[b]) >> 8;
+                out[0] = (uint16_t)(l0 * w0 + l1 * w1);
+                continue;
+            }
+
+            for (int c = 0; c < channels; c++) {
+                int s = output.map[c];
+                out[c] = (uint16_t)(p0[s] * w0 + p1[s] * w1);
+            }
+        }
+    }
+
+    static void Vertical(Output& output, int dy) {
+        const int channels = output.work_channels;
+        const int w1 = output.wy[dy], w0 = ONE - w1;
+        const uint16_t* r0 = output.rows[output.y0[dy] & 1].data();
+        const uint16_t* r1 = output.rows[output.y1[dy] & 1].data();
+        uint8_t* out = output.image.ptr<uint8_t>(output.pad_y + dy) + output.pad_x * output.channels;
+
+        for (int dx = 0; dx < output.content_width; dx++, out += output.channels) {
+            for (int c = 0; c < channels; c++) {
+                int i = dx * channels + c;
+                out[c] = (uint8_t)((r0[i] * w0 + r1[i] * w1 + (1 << (2 * SHIFT - 1))) >> (2 * SHIFT));
+            }
+        }
+    }
+
+    std::vector<Output>     m_outputs;
+    int                     m_srcWidth;
+    int                     m_srcHeight;
+    GstVideoFormat          m_srcFormat;
+};